@@ -0,0 +1,224 @@
+//
+// Measures the CPU cost of stroke expansion. The strokes are passed to a renderer
+// which only counts the vertices, so no window or GL context is needed.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "nanovg.h"
+
+#define BENCH_FRAMES 200
+#define BENCH_LINES 20
+#define BENCH_POINTS 500
+
+static int benchVerts = 0;
+
+static int nullRenderCreate(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+	return 1;
+}
+
+static int nullRenderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data)
+{
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(type);
+	NVG_NOTUSED(w);
+	NVG_NOTUSED(h);
+	NVG_NOTUSED(imageFlags);
+	NVG_NOTUSED(data);
+	return 1;
+}
+
+static int nullRenderDeleteTexture(void* uptr, int image)
+{
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(image);
+	return 1;
+}
+
+static int nullRenderUpdateTexture(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(image);
+	NVG_NOTUSED(x);
+	NVG_NOTUSED(y);
+	NVG_NOTUSED(w);
+	NVG_NOTUSED(h);
+	NVG_NOTUSED(data);
+	return 1;
+}
+
+static int nullRenderGetTextureSize(void* uptr, int image, int* w, int* h)
+{
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(image);
+	*w = *h = 512;
+	return 1;
+}
+
+static void nullRenderViewport(void* uptr, float width, float height, float devicePixelRatio)
+{
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(width);
+	NVG_NOTUSED(height);
+	NVG_NOTUSED(devicePixelRatio);
+}
+
+static void nullRenderCancel(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+}
+
+static void nullRenderFlush(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+}
+
+static void nullRenderFill(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+						   const float* bounds, const NVGpath* paths, int npaths)
+{
+	int i;
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(paint);
+	NVG_NOTUSED(compositeOperation);
+	NVG_NOTUSED(scissor);
+	NVG_NOTUSED(fringe);
+	NVG_NOTUSED(bounds);
+	for (i = 0; i < npaths; i++)
+		benchVerts += paths[i].nfill + paths[i].nstroke;
+}
+
+static void nullRenderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+							 float strokeWidth, const NVGpath* paths, int npaths)
+{
+	int i;
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(paint);
+	NVG_NOTUSED(compositeOperation);
+	NVG_NOTUSED(scissor);
+	NVG_NOTUSED(fringe);
+	NVG_NOTUSED(strokeWidth);
+	for (i = 0; i < npaths; i++)
+		benchVerts += paths[i].nstroke;
+}
+
+static void nullRenderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+								const NVGvertex* verts, int nverts)
+{
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(paint);
+	NVG_NOTUSED(compositeOperation);
+	NVG_NOTUSED(scissor);
+	NVG_NOTUSED(verts);
+	benchVerts += nverts;
+}
+
+static void nullRenderDelete(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+}
+
+static NVGcontext* nullCreate(void)
+{
+	NVGparams params;
+	memset(&params, 0, sizeof(params));
+	params.renderCreate = nullRenderCreate;
+	params.renderCreateTexture = nullRenderCreateTexture;
+	params.renderDeleteTexture = nullRenderDeleteTexture;
+	params.renderUpdateTexture = nullRenderUpdateTexture;
+	params.renderGetTextureSize = nullRenderGetTextureSize;
+	params.renderViewport = nullRenderViewport;
+	params.renderCancel = nullRenderCancel;
+	params.renderFlush = nullRenderFlush;
+	params.renderFill = nullRenderFill;
+	params.renderStroke = nullRenderStroke;
+	params.renderTriangles = nullRenderTriangles;
+	params.renderDelete = nullRenderDelete;
+	params.edgeAntiAlias = 1;
+	return nvgCreateInternal(&params);
+}
+
+// Zig-zag chart lines, so that every point is a join.
+static void drawLines(NVGcontext* vg, int join, int cap, float width)
+{
+	int i, j;
+	nvgLineJoin(vg, join);
+	nvgLineCap(vg, cap);
+	nvgStrokeWidth(vg, width);
+	nvgStrokeColor(vg, nvgRGBA(255,255,255,255));
+	for (i = 0; i < BENCH_LINES; i++) {
+		nvgBeginPath(vg);
+		for (j = 0; j < BENCH_POINTS; j++) {
+			float x = 10 + j*2.0f;
+			float y = 20 + i*30 + sinf(j*0.37f + i) * 12 + ((j*7919 + i) % 5) * 2;
+			if (j == 0)
+				nvgMoveTo(vg, x, y);
+			else
+				nvgLineTo(vg, x, y);
+		}
+		nvgStroke(vg);
+	}
+}
+
+// Short segments, so that the caps dominate.
+static void drawDashes(NVGcontext* vg, int cap, float width)
+{
+	int i, j;
+	nvgLineCap(vg, cap);
+	nvgStrokeWidth(vg, width);
+	nvgStrokeColor(vg, nvgRGBA(255,255,255,255));
+	for (i = 0; i < BENCH_LINES; i++) {
+		nvgBeginPath(vg);
+		for (j = 0; j < BENCH_POINTS/2; j++) {
+			float x = 10 + j*4.0f, y = 20 + i*30;
+			nvgMoveTo(vg, x, y);
+			nvgLineTo(vg, x + 2.0f, y + (j % 3));
+		}
+		nvgStroke(vg);
+	}
+}
+
+static void runBench(NVGcontext* vg, const char* name, int join, int cap, float width, int dashes)
+{
+	clock_t start;
+	double ms, mpts;
+	int i;
+
+	benchVerts = 0;
+	start = clock();
+	for (i = 0; i < BENCH_FRAMES; i++) {
+		nvgBeginFrame(vg, 1024, 768, 1.0f);
+		if (dashes)
+			drawDashes(vg, cap, width);
+		else
+			drawLines(vg, join, cap, width);
+		nvgEndFrame(vg);
+	}
+	ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC / BENCH_FRAMES;
+	mpts = ms > 0.0 ? BENCH_LINES*BENCH_POINTS / (ms * 1000.0) : 0.0;
+	printf("%-24s %8.3f ms/frame %8.2f Mpoints/s %9d verts/frame\n", name, ms, mpts, benchVerts / BENCH_FRAMES);
+}
+
+int main(void)
+{
+	NVGcontext* vg = nullCreate();
+	if (vg == NULL) {
+		printf("Could not init nanovg.\n");
+		return -1;
+	}
+
+	runBench(vg, "miter/butt", NVG_MITER, NVG_BUTT, 3.0f, 0);
+	runBench(vg, "round/round", NVG_ROUND, NVG_ROUND, 3.0f, 0);
+	runBench(vg, "bevel/square", NVG_BEVEL, NVG_SQUARE, 3.0f, 0);
+	runBench(vg, "miter/butt, wide", NVG_MITER, NVG_BUTT, 20.0f, 0);
+	runBench(vg, "round/round, wide", NVG_ROUND, NVG_ROUND, 20.0f, 0);
+	runBench(vg, "bevel/square, wide", NVG_BEVEL, NVG_SQUARE, 20.0f, 0);
+	runBench(vg, "round caps", NVG_MITER, NVG_ROUND, 3.0f, 1);
+	runBench(vg, "round caps, wide", NVG_MITER, NVG_ROUND, 20.0f, 1);
+
+	nvgDeleteInternal(vg);
+	return 0;
+}
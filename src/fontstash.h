@@ -21,9 +21,18 @@
 
 #define FONS_INVALID -1
 
+// Number of separately tracked changed regions of an atlas page.
+#ifndef FONS_MAX_DIRTY_RECTS
+#	define FONS_MAX_DIRTY_RECTS 16
+#endif
+
 enum FONSflags {
 	FONS_ZERO_TOPLEFT = 1,
 	FONS_ZERO_BOTTOMLEFT = 2,
+	// Glyphs are rasterized once as signed distance fields, and scaled and blurred when drawn.
+	FONS_SDF = 4,
+	// Like FONS_SDF, but only for blurred text. Unblurred glyphs stay coverage bitmaps.
+	FONS_SDF_BLUR = 8,
 };
 
 enum FONSalign {
@@ -70,6 +79,7 @@ struct FONSquad
 {
 	float x0,y0,s0,t0;
 	float x1,y1,s1,t1;
+	int page;
 };
 typedef struct FONSquad FONSquad;
 
@@ -84,6 +94,7 @@ struct FONStextIter {
 	const char* end;
 	unsigned int utf8state;
 	int bitmapOption;
+	int snapped;
 };
 typedef struct FONStextIter FONStextIter;
 
@@ -100,6 +111,20 @@ void fonsGetAtlasSize(FONScontext* s, int* width, int* height);
 int fonsExpandAtlas(FONScontext* s, int width, int height);
 // Resets the whole stash.
 int fonsResetAtlas(FONScontext* stash, int width, int height);
+// Rasterizes glyphs only at sizes of a geometric series with the given steps per octave,
+// and scales their quads to the size. Use 0 to rasterize at every size.
+void fonsSetSizeBuckets(FONScontext* s, int steps);
+// Rasterizes at most the given number of new glyphs per frame, 0 for no limit. Glyphs over the budget
+// are drawn from a cached bitmap at another size, or left out, until a later frame rasterizes them.
+void fonsSetGlyphBudget(FONScontext* s, int glyphs);
+// Returns the number of glyphs rasterized, and the number of lookups deferred by the budget, during this frame.
+void fonsGetGlyphStats(FONScontext* s, int* rasterized, int* deferred);
+// Starts a new frame. When the atlas is full, pages not used since the previous frame get evicted.
+void fonsBeginFrame(FONScontext* s);
+// Returns a counter which changes whenever previously returned quads may have become invalid.
+int fonsGetAtlasGeneration(FONScontext* s);
+// Marks the pages in the bit mask as used during this frame, for callers which keep quads.
+void fonsTouchPages(FONScontext* s, unsigned int pages);
 
 // Add fonts
 int fonsAddFont(FONScontext* s, const char* name, const char* path);
@@ -135,6 +160,29 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, struct FONSquad* qu
 const unsigned char* fonsGetTextureData(FONScontext* stash, int* width, int* height);
 int fonsValidateTexture(FONScontext* s, int* dirty);
 
+// Returns 0 if glyphs are not distance fields. Otherwise the field value v [0..1] maps to
+// coverage as clamp((v - edge) * scale + 0.5, 0, 1) at the current size and blur.
+int fonsGetSDFParams(FONScontext* s, float* edge, float* scale);
+
+// Pull texture changes of each atlas page, quads refer to their page.
+int fonsGetPageCount(FONScontext* s);
+const unsigned char* fonsGetPageData(FONScontext* s, int page, int* width, int* height);
+int fonsValidatePage(FONScontext* s, int page, int* dirty);
+// Like fonsValidatePage(), but returns the changed regions separately. Fills up to
+// FONS_MAX_DIRTY_RECTS rects as x0,y0,x1,y1 and returns their count.
+int fonsValidatePageRects(FONScontext* s, int page, int* rects);
+
+// Glyphs rasterized ahead of use. fonsPrewarmBegin() collects the glyphs of the code points at the
+// current font, size and blur which are not in the atlas yet. fonsPrewarmRasterize() renders one of
+// them into a staging bitmap without touching the stash, so distinct glyphs can be rasterized on
+// other threads. fonsPrewarmEnd() packs the bitmaps into the atlas and frees the batch.
+typedef struct FONSprewarm FONSprewarm;
+FONSprewarm* fonsPrewarmBegin(FONScontext* s, const unsigned int* codepoints, int n);
+int fonsPrewarmCount(FONSprewarm* p);
+void fonsPrewarmRasterize(FONSprewarm* p, int i);
+int fonsPrewarmEnd(FONScontext* s, FONSprewarm* p);
+void fonsPrewarmFree(FONSprewarm* p);
+
 // Draws the stash texture for debugging
 void fonsDrawDebug(FONScontext* s, float x, float y);
 
@@ -349,6 +397,28 @@ int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 #ifndef FONS_MAX_FALLBACKS
 #	define FONS_MAX_FALLBACKS 20
 #endif
+// Number of fixed size atlas pages. The render callbacks only see the first page,
+// use the text iterator and fonsValidatePage() to draw from more pages.
+#ifndef FONS_MAX_PAGES
+#	define FONS_MAX_PAGES 1
+#endif
+// Size of the distance field glyphs in pixels, and how far the field extends outside them.
+#ifndef FONS_SDF_SIZE
+#	define FONS_SDF_SIZE 48
+#endif
+#ifndef FONS_SDF_SPREAD
+#	define FONS_SDF_SPREAD 6
+#endif
+// Number of adjacent columns blurred together, a multiple of 8.
+#ifndef FONS_BLUR_STRIP
+#	define FONS_BLUR_STRIP 64
+#endif
+
+// The blur uses SSE2 when available, define FONS_NO_SIMD to use only plain C.
+#if !defined(FONS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#	define FONS_SSE2
+#	include <emmintrin.h>
+#endif
 
 static unsigned int fons__hashint(unsigned int a)
 {
@@ -371,6 +441,16 @@ static int fons__maxi(int a, int b)
 	return a > b ? a : b;
 }
 
+static float fons__minf(float a, float b)
+{
+	return a < b ? a : b;
+}
+
+static float fons__maxf(float a, float b)
+{
+	return a > b ? a : b;
+}
+
 struct FONSglyph
 {
 	unsigned int codepoint;
@@ -379,6 +459,8 @@ struct FONSglyph
 	short size, blur;
 	short x0,y0,x1,y1;
 	short xadv,xoff,yoff;
+	short page;
+	short prewarm;	// Queued for pre-warming, the bitmap is not in the atlas yet.
 };
 typedef struct FONSglyph FONSglyph;
 
@@ -426,14 +508,50 @@ struct FONSatlas
 };
 typedef struct FONSatlas FONSatlas;
 
+struct FONSpage
+{
+	FONSatlas* atlas;
+	unsigned char* texData;
+	int dirtyRects[FONS_MAX_DIRTY_RECTS][4];
+	int ndirty;
+	int lastUsed;
+};
+typedef struct FONSpage FONSpage;
+
+struct FONSprewarmGlyph
+{
+	FONSfont* font;
+	FONSfont* renderFont;
+	unsigned int codepoint;
+	int index;
+	float scale;
+	int gw, gh;
+	unsigned char* bitmap;
+};
+typedef struct FONSprewarmGlyph FONSprewarmGlyph;
+
+struct FONSprewarm
+{
+	short isize, iblur;		// Requested size and blur.
+	short rsize, rblur;		// Size and blur of the rasterized glyphs.
+	int pad, sdf;
+	FONSprewarmGlyph* glyphs;
+	int nglyphs;
+};
+
 struct FONScontext
 {
 	FONSparams params;
 	float itw,ith;
-	unsigned char* texData;
-	int dirtyRect[4];
+	FONSpage pages[FONS_MAX_PAGES];
+	int npages;
+	int frame;
+	int generation;
+	int sizeBuckets;
+	int glyphBudget;
+	int nrasterized;
+	int ndeferred;
 	FONSfont** fonts;
-	FONSatlas* atlas;
 	int cfonts;
 	int nfonts;
 	float verts[FONS_VERTEX_COUNT*2];
@@ -455,6 +573,10 @@ static void* fons__tmpalloc(size_t size, void* up)
 	unsigned char* ptr;
 	FONScontext* stash = (FONScontext*)up;
 
+	// Glyphs rasterized without a stash, e.g. on other threads, allocate from the heap.
+	if (stash == NULL)
+		return malloc(size);
+
 	// 16-byte align the returned pointer
 	size = (size + 0xf) & ~0xf;
 
@@ -470,9 +592,8 @@ static void* fons__tmpalloc(size_t size, void* up)
 
 static void fons__tmpfree(void* ptr, void* up)
 {
-	(void)ptr;
-	(void)up;
-	// empty
+	if (up == NULL)
+		free(ptr);
 }
 
 #endif // STB_TRUETYPE_IMPLEMENTATION
@@ -698,25 +819,143 @@ static int fons__atlasAddRect(FONSatlas* atlas, int rw, int rh, int* rx, int* ry
 	return 1;
 }
 
-static void fons__addWhiteRect(FONScontext* stash, int w, int h)
+// Adds a changed region to the page. It is merged with the dirty rect which grows the least,
+// if the union uploads at most 1.5x the pixels of the two rects, or if the list is full.
+static void fons__addDirtyRect(FONSpage* page, int x0, int y0, int x1, int y1)
+{
+	int i, best = -1, bestCost = 0, bestArea = 0, area = (x1-x0)*(y1-y0);
+	int* r;
+
+	for (i = 0; i < page->ndirty; i++) {
+		int rarea, cost;
+		r = page->dirtyRects[i];
+		rarea = (r[2]-r[0])*(r[3]-r[1]);
+		cost = (fons__maxi(r[2], x1) - fons__mini(r[0], x0)) * (fons__maxi(r[3], y1) - fons__mini(r[1], y0)) - rarea - area;
+		if (best == -1 || cost < bestCost) {
+			best = i;
+			bestCost = cost;
+			bestArea = rarea;
+		}
+	}
+
+	if (best != -1 && (bestCost*2 <= bestArea + area || page->ndirty == FONS_MAX_DIRTY_RECTS)) {
+		r = page->dirtyRects[best];
+		r[0] = fons__mini(r[0], x0);
+		r[1] = fons__mini(r[1], y0);
+		r[2] = fons__maxi(r[2], x1);
+		r[3] = fons__maxi(r[3], y1);
+		return;
+	}
+
+	r = page->dirtyRects[page->ndirty++];
+	r[0] = x0;
+	r[1] = y0;
+	r[2] = x1;
+	r[3] = y1;
+}
+
+static void fons__addWhiteRect(FONScontext* stash, FONSpage* page, int w, int h)
 {
 	int x, y, gx, gy;
 	unsigned char* dst;
-	if (fons__atlasAddRect(stash->atlas, w, h, &gx, &gy) == 0)
+	if (fons__atlasAddRect(page->atlas, w, h, &gx, &gy) == 0)
 		return;
 
 	// Rasterize
-	dst = &stash->texData[gx + gy * stash->params.width];
+	dst = &page->texData[gx + gy * stash->params.width];
 	for (y = 0; y < h; y++) {
 		for (x = 0; x < w; x++)
 			dst[x] = 0xff;
 		dst += stash->params.width;
 	}
 
-	stash->dirtyRect[0] = fons__mini(stash->dirtyRect[0], gx);
-	stash->dirtyRect[1] = fons__mini(stash->dirtyRect[1], gy);
-	stash->dirtyRect[2] = fons__maxi(stash->dirtyRect[2], gx+w);
-	stash->dirtyRect[3] = fons__maxi(stash->dirtyRect[3], gy+h);
+	fons__addDirtyRect(page, gx, gy, gx+w, gy+h);
+}
+
+static int fons__resetPage(FONScontext* stash, FONSpage* page)
+{
+	int width = stash->params.width;
+	int height = stash->params.height;
+
+	fons__atlasReset(page->atlas, width, height);
+
+	// Clear texture data.
+	page->texData = (unsigned char*)realloc(page->texData, width * height);
+	if (page->texData == NULL) return 0;
+	memset(page->texData, 0, width * height);
+
+	// Reset dirty rects
+	page->ndirty = 0;
+	page->lastUsed = stash->frame;
+
+	// Add white rect at 0,0 for debug drawing.
+	fons__addWhiteRect(stash, page, 2,2);
+
+	return 1;
+}
+
+static int fons__addPage(FONScontext* stash)
+{
+	FONSpage* page = &stash->pages[stash->npages];
+	if (page->atlas == NULL) {
+		page->atlas = fons__allocAtlas(stash->params.width, stash->params.height, FONS_INIT_ATLAS_NODES);
+		if (page->atlas == NULL) return 0;
+	}
+	if (!fons__resetPage(stash, page)) return 0;
+	stash->npages++;
+	return 1;
+}
+
+static void fons__evictPage(FONScontext* stash, int page)
+{
+	int i, j;
+	stash->generation++;
+	// Drop the bitmaps of the glyphs on the page, their metrics stay cached.
+	for (i = 0; i < stash->nfonts; i++) {
+		FONSfont* font = stash->fonts[i];
+		for (j = 0; j < font->nglyphs; j++) {
+			FONSglyph* glyph = &font->glyphs[j];
+			if (glyph->page == page && glyph->x0 >= 0) {
+				// Keep x1-x0 and y1-y0 the size of the glyph, like for glyphs never rasterized.
+				glyph->x1 -= glyph->x0 + 1;
+				glyph->y1 -= glyph->y0 + 1;
+				glyph->x0 = -1;
+				glyph->y0 = -1;
+			}
+		}
+	}
+}
+
+// Returns the page where the rect was placed, or -1 if it did not fit.
+static int fons__pageAddRect(FONScontext* stash, int rw, int rh, int* rx, int* ry)
+{
+	int i, lru;
+
+	for (i = stash->npages-1; i >= 0; i--) {
+		if (fons__atlasAddRect(stash->pages[i].atlas, rw, rh, rx, ry))
+			return i;
+	}
+
+	// Start a new page if there is room for one.
+	if (stash->npages < FONS_MAX_PAGES) {
+		if (!fons__addPage(stash))
+			return -1;
+		i = stash->npages-1;
+		return fons__atlasAddRect(stash->pages[i].atlas, rw, rh, rx, ry) ? i : -1;
+	}
+
+	// Evict the least recently used page, unless it has been used during this frame.
+	lru = 0;
+	for (i = 1; i < stash->npages; i++) {
+		if (stash->pages[i].lastUsed < stash->pages[lru].lastUsed)
+			lru = i;
+	}
+	if (stash->pages[lru].lastUsed >= stash->frame)
+		return -1;
+	fons__evictPage(stash, lru);
+	if (!fons__resetPage(stash, &stash->pages[lru]))
+		return -1;
+	return fons__atlasAddRect(stash->pages[lru].atlas, rw, rh, rx, ry) ? lru : -1;
 }
 
 FONScontext* fonsCreateInternal(FONSparams* params)
@@ -742,9 +981,6 @@ FONScontext* fonsCreateInternal(FONSparams* params)
 			goto error;
 	}
 
-	stash->atlas = fons__allocAtlas(stash->params.width, stash->params.height, FONS_INIT_ATLAS_NODES);
-	if (stash->atlas == NULL) goto error;
-
 	// Allocate space for fonts.
 	stash->fonts = (FONSfont**)malloc(sizeof(FONSfont*) * FONS_INIT_FONTS);
 	if (stash->fonts == NULL) goto error;
@@ -752,20 +988,10 @@ FONScontext* fonsCreateInternal(FONSparams* params)
 	stash->cfonts = FONS_INIT_FONTS;
 	stash->nfonts = 0;
 
-	// Create texture for the cache.
+	// Create the first page of the cache, more are added as needed.
 	stash->itw = 1.0f/stash->params.width;
 	stash->ith = 1.0f/stash->params.height;
-	stash->texData = (unsigned char*)malloc(stash->params.width * stash->params.height);
-	if (stash->texData == NULL) goto error;
-	memset(stash->texData, 0, stash->params.width * stash->params.height);
-
-	stash->dirtyRect[0] = stash->params.width;
-	stash->dirtyRect[1] = stash->params.height;
-	stash->dirtyRect[2] = 0;
-	stash->dirtyRect[3] = 0;
-
-	// Add white rect at 0,0 for debug drawing.
-	fons__addWhiteRect(stash, 2,2);
+	if (!fons__addPage(stash)) goto error;
 
 	fonsPushState(stash);
 	fonsClearState(stash);
@@ -787,6 +1013,7 @@ int fonsAddFallbackFont(FONScontext* stash, int base, int fallback)
 	FONSfont* baseFont = stash->fonts[base];
 	if (baseFont->nfallbacks < FONS_MAX_FALLBACKS) {
 		baseFont->fallbacks[baseFont->nfallbacks++] = fallback;
+		stash->generation++;
 		return 1;
 	}
 	return 0;
@@ -989,10 +1216,165 @@ static FONSglyph* fons__allocGlyph(FONSfont* font)
 #define APREC 16
 #define ZPREC 7
 
-static void fons__blurCols(unsigned char* dst, int w, int h, int dstStride, int alpha)
+// Blurs n adjacent columns side by side, so that the rows are read in order instead of
+// one column at a time.
+static void fons__blurStrip(unsigned char* dst, int n, int h, int dstStride, int alpha)
 {
+	int z[FONS_BLUR_STRIP];
+	unsigned char* row;
 	int x, y;
-	for (y = 0; y < h; y++) {
+
+	for (x = 0; x < n; x++)
+		z[x] = 0; // force zero border
+	for (y = 1; y < h; y++) {
+		row = &dst[y*dstStride];
+		for (x = 0; x < n; x++) {
+			z[x] += (alpha * (((int)(row[x]) << ZPREC) - z[x])) >> APREC;
+			row[x] = (unsigned char)(z[x] >> ZPREC);
+		}
+	}
+	row = &dst[(h-1)*dstStride];
+	for (x = 0; x < n; x++) {
+		row[x] = 0; // force zero border
+		z[x] = 0;
+	}
+	for (y = h-2; y >= 0; y--) {
+		row = &dst[y*dstStride];
+		for (x = 0; x < n; x++) {
+			z[x] += (alpha * (((int)(row[x]) << ZPREC) - z[x])) >> APREC;
+			row[x] = (unsigned char)(z[x] >> ZPREC);
+		}
+	}
+	for (x = 0; x < n; x++)
+		dst[x] = 0; // force zero border
+}
+
+#ifdef FONS_SSE2
+// One step of the blur recurrence for 8 lanes. The values and their differences fit 16 bits, and
+// alpha*d >> APREC is the signed high half of the product, corrected when alpha uses bit 15.
+static __inline __m128i fons__blurLanes(__m128i* z, __m128i v, __m128i alpha, __m128i hi)
+{
+	__m128i d = _mm_sub_epi16(_mm_slli_epi16(v, ZPREC), *z);
+	*z = _mm_add_epi16(*z, _mm_add_epi16(_mm_mulhi_epi16(d, alpha), _mm_and_si128(d, hi)));
+	return _mm_srli_epi16(*z, ZPREC);
+}
+
+static void fons__transpose8(__m128i* v)
+{
+	__m128i t0 = _mm_unpacklo_epi16(v[0], v[1]), t1 = _mm_unpackhi_epi16(v[0], v[1]);
+	__m128i t2 = _mm_unpacklo_epi16(v[2], v[3]), t3 = _mm_unpackhi_epi16(v[2], v[3]);
+	__m128i t4 = _mm_unpacklo_epi16(v[4], v[5]), t5 = _mm_unpackhi_epi16(v[4], v[5]);
+	__m128i t6 = _mm_unpacklo_epi16(v[6], v[7]), t7 = _mm_unpackhi_epi16(v[6], v[7]);
+	__m128i u0 = _mm_unpacklo_epi32(t0, t2), u1 = _mm_unpackhi_epi32(t0, t2);
+	__m128i u2 = _mm_unpacklo_epi32(t1, t3), u3 = _mm_unpackhi_epi32(t1, t3);
+	__m128i u4 = _mm_unpacklo_epi32(t4, t6), u5 = _mm_unpackhi_epi32(t4, t6);
+	__m128i u6 = _mm_unpacklo_epi32(t5, t7), u7 = _mm_unpackhi_epi32(t5, t7);
+	v[0] = _mm_unpacklo_epi64(u0, u4); v[1] = _mm_unpackhi_epi64(u0, u4);
+	v[2] = _mm_unpacklo_epi64(u1, u5); v[3] = _mm_unpackhi_epi64(u1, u5);
+	v[4] = _mm_unpacklo_epi64(u2, u6); v[5] = _mm_unpackhi_epi64(u2, u6);
+	v[6] = _mm_unpacklo_epi64(u3, u7); v[7] = _mm_unpackhi_epi64(u3, u7);
+}
+
+// Like fons__blurCols() for 8 rows, one row per lane. Blocks of 8x8 pixels are transposed
+// so that the lanes step along the rows together, the remaining columns are done per row.
+static void fons__blurCols8(unsigned char* dst, int w, int dstStride, int alpha)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_set1_epi16((short)alpha);
+	__m128i hi = alpha >= 0x8000 ? _mm_set1_epi16(-1) : zero;
+	__m128i z = zero, v[8];
+	short zs[8];
+	int x, y, i;
+
+	for (x = 1; x + 8 <= w; x += 8) {
+		for (y = 0; y < 8; y++)
+			v[y] = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&dst[x + y*dstStride]), zero);
+		fons__transpose8(v);
+		for (i = 0; i < 8; i++)
+			v[i] = fons__blurLanes(&z, v[i], a, hi);
+		fons__transpose8(v);
+		for (y = 0; y < 8; y++)
+			_mm_storel_epi64((__m128i*)&dst[x + y*dstStride], _mm_packus_epi16(v[y], zero));
+	}
+	_mm_storeu_si128((__m128i*)zs, z);
+	for (y = 0; y < 8; y++) {
+		unsigned char* row = &dst[y*dstStride];
+		int zy = zs[y];
+		for (i = x; i < w; i++) {
+			zy += (alpha * (((int)(row[i]) << ZPREC) - zy)) >> APREC;
+			row[i] = (unsigned char)(zy >> ZPREC);
+		}
+		row[w-1] = 0; // force zero border
+	}
+
+	z = zero;
+	for (x = w-2; x >= 7; x -= 8) {
+		for (y = 0; y < 8; y++)
+			v[y] = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&dst[x-7 + y*dstStride]), zero);
+		fons__transpose8(v);
+		for (i = 7; i >= 0; i--)
+			v[i] = fons__blurLanes(&z, v[i], a, hi);
+		fons__transpose8(v);
+		for (y = 0; y < 8; y++)
+			_mm_storel_epi64((__m128i*)&dst[x-7 + y*dstStride], _mm_packus_epi16(v[y], zero));
+	}
+	_mm_storeu_si128((__m128i*)zs, z);
+	for (y = 0; y < 8; y++) {
+		unsigned char* row = &dst[y*dstStride];
+		int zy = zs[y];
+		for (i = x; i >= 0; i--) {
+			zy += (alpha * (((int)(row[i]) << ZPREC) - zy)) >> APREC;
+			row[i] = (unsigned char)(zy >> ZPREC);
+		}
+		row[0] = 0; // force zero border
+	}
+}
+
+// Like fons__blurStrip() for n groups of 8 columns, one column per lane.
+static void fons__blurStrip8(unsigned char* dst, int n, int h, int dstStride, int alpha)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_set1_epi16((short)alpha);
+	__m128i hi = alpha >= 0x8000 ? _mm_set1_epi16(-1) : zero;
+	__m128i z[FONS_BLUR_STRIP/8];
+	unsigned char* row;
+	int i, y;
+
+	for (i = 0; i < n; i++)
+		z[i] = zero; // force zero border
+	for (y = 1; y < h; y++) {
+		row = &dst[y*dstStride];
+		for (i = 0; i < n; i++) {
+			__m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&row[i*8]), zero);
+			_mm_storel_epi64((__m128i*)&row[i*8], _mm_packus_epi16(fons__blurLanes(&z[i], v, a, hi), zero));
+		}
+	}
+	row = &dst[(h-1)*dstStride];
+	for (i = 0; i < n; i++) {
+		_mm_storel_epi64((__m128i*)&row[i*8], zero); // force zero border
+		z[i] = zero;
+	}
+	for (y = h-2; y >= 0; y--) {
+		row = &dst[y*dstStride];
+		for (i = 0; i < n; i++) {
+			__m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&row[i*8]), zero);
+			_mm_storel_epi64((__m128i*)&row[i*8], _mm_packus_epi16(fons__blurLanes(&z[i], v, a, hi), zero));
+		}
+	}
+	for (i = 0; i < n; i++)
+		_mm_storel_epi64((__m128i*)&dst[i*8], zero); // force zero border
+}
+#endif
+
+static void fons__blurCols(unsigned char* dst, int w, int h, int dstStride, int alpha)
+{
+	int x, y = 0;
+#ifdef FONS_SSE2
+	for (; y + 8 <= h; y += 8)
+		fons__blurCols8(&dst[y*dstStride], w, dstStride, alpha);
+	dst += y*dstStride;
+#endif
+	for (; y < h; y++) {
 		int z = 0; // force zero border
 		for (x = 1; x < w; x++) {
 			z += (alpha * (((int)(dst[x]) << ZPREC) - z)) >> APREC;
@@ -1011,21 +1393,16 @@ static void fons__blurCols(unsigned char* dst, int w, int h, int dstStride, int
 
 static void fons__blurRows(unsigned char* dst, int w, int h, int dstStride, int alpha)
 {
-	int x, y;
-	for (x = 0; x < w; x++) {
-		int z = 0; // force zero border
-		for (y = dstStride; y < h*dstStride; y += dstStride) {
-			z += (alpha * (((int)(dst[y]) << ZPREC) - z)) >> APREC;
-			dst[y] = (unsigned char)(z >> ZPREC);
-		}
-		dst[(h-1)*dstStride] = 0; // force zero border
-		z = 0;
-		for (y = (h-2)*dstStride; y >= 0; y -= dstStride) {
-			z += (alpha * (((int)(dst[y]) << ZPREC) - z)) >> APREC;
-			dst[y] = (unsigned char)(z >> ZPREC);
-		}
-		dst[0] = 0; // force zero border
-		dst++;
+	int x = 0, n;
+#ifdef FONS_SSE2
+	for (; x + 8 <= w; x += n) {
+		n = fons__mini(FONS_BLUR_STRIP, (w - x) & ~7);
+		fons__blurStrip8(&dst[x], n / 8, h, dstStride, alpha);
+	}
+#endif
+	for (; x < w; x += n) {
+		n = fons__mini(FONS_BLUR_STRIP, w - x);
+		fons__blurStrip(&dst[x], n, h, dstStride, alpha);
 	}
 }
 
@@ -1049,43 +1426,145 @@ static void fons__blur(FONScontext* stash, unsigned char* dst, int w, int h, int
 //	fons__blurcols(dst, w, h, dstStride, alpha);
 }
 
-static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned int codepoint,
-								 short isize, short iblur, int bitmapOption)
+// Width of a distance field edge in pixels, the blur spreads it out like fons__blur() does.
+static float fons__sdfWidth(float blur)
 {
-	int i, g, advance, lsb, x0, y0, x1, y1, gw, gh, gx, gy, x, y;
-	float scale;
-	FONSglyph* glyph = NULL;
-	unsigned int h;
-	float size = isize/10.0f;
-	int pad, added;
-	unsigned char* bdst;
-	unsigned char* dst;
-	FONSfont* renderFont = font;
+	return 1.0f + 2.0f * fons__minf(blur, 20.0f) * 0.57735f;
+}
 
-	if (isize < 2) return NULL;
-	if (iblur > 20) iblur = 20;
-	pad = iblur+2;
+// Distance from a texel center to an edge passing through it, along the gradient of the coverage a.
+// From Stefan Gustavson's anti-aliased Euclidean distance transform.
+static float fons__edgeDist(float gx, float gy, float a)
+{
+	float t, a1;
+	if (gx == 0.0f || gy == 0.0f)
+		return 0.5f - a;
+	t = sqrtf(gx*gx + gy*gy);
+	gx = fabsf(gx / t);
+	gy = fabsf(gy / t);
+	if (gx < gy) {
+		t = gx; gx = gy; gy = t;
+	}
+	a1 = 0.5f * gy / gx;
+	if (a < a1)
+		return 0.5f * (gx + gy) - sqrtf(2.0f * gx * gy * a);
+	if (a < 1.0f - a1)
+		return (0.5f - a) * gx;
+	return -0.5f * (gx + gy) + sqrtf(2.0f * gx * gy * (1.0f - a));
+}
 
-	// Reset allocator.
-	stash->nscratch = 0;
+// Turns the coverage in dst into a signed distance field, stored as 128 at the edge and
+// 128/FONS_SDF_SPREAD per pixel towards the inside. Each texel on the edge gives a point
+// on the outline, the distance is the distance to the nearest one.
+static int fons__sdfScratchSize(int w, int h)
+{
+	return ((w*h + 3) & ~3) + w*h*2*(int)sizeof(float);
+}
 
-	// Find code point and size.
-	h = fons__hashint(codepoint) & (FONS_HASH_LUT_SIZE-1);
-	i = font->lut[h];
-	while (i != -1) {
-		if (font->glyphs[i].codepoint == codepoint && font->glyphs[i].size == isize && font->glyphs[i].blur == iblur) {
-			glyph = &font->glyphs[i];
-			if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL || (glyph->x0 >= 0 && glyph->y0 >= 0)) {
-			  return glyph;
+// Returns 0 if the scratch buffer is too small, see fons__sdfScratchSize().
+static int fons__sdf(unsigned char* scratch, int nscratch, unsigned char* dst, int w, int h, int dstStride)
+{
+	unsigned char* cov = scratch;
+	float* pts = (float*)&scratch[(w*h + 3) & ~3];
+	int x, y, i, j, r = FONS_SDF_SPREAD+1;
+
+	if (fons__sdfScratchSize(w, h) > nscratch)
+		return 0;
+	for (y = 0; y < h; y++)
+		memcpy(&cov[y*w], &dst[y*dstStride], w);
+
+	// Find the edge points, the glyph has an empty border so the neighbours can be read directly.
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			float* pt = &pts[(x + y*w)*2];
+			const unsigned char* c = &cov[x + y*w];
+			pt[0] = pt[1] = 1e6f;
+			if (x == 0 || y == 0 || x == w-1 || y == h-1)
+				continue;
+			if ((c[0] == 0 || c[0] == 255) && c[-1] == c[0] && c[1] == c[0] && c[-w] == c[0] && c[w] == c[0])
+				continue;
+			{
+				float gx = (c[-w+1] + 1.41421356f*c[1] + c[w+1]) - (c[-w-1] + 1.41421356f*c[-1] + c[w-1]);
+				float gy = (c[w-1] + 1.41421356f*c[w] + c[w+1]) - (c[-w-1] + 1.41421356f*c[-w] + c[-w+1]);
+				float gl = sqrtf(gx*gx + gy*gy);
+				float d = fons__edgeDist(gx, gy, c[0] / 255.0f);
+				if (gl > 0.0f) {
+					pt[0] = gx / gl * d;
+					pt[1] = gy / gl * d;
+				} else {
+					pt[0] = pt[1] = 0.0f;
+				}
 			}
-			// At this point, glyph exists but the bitmap data is not yet created.
-			break;
 		}
+	}
+
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			float best = (float)FONS_SDF_SPREAD;
+			int v;
+			for (j = fons__maxi(y-r, 0); j <= fons__mini(y+r, h-1); j++) {
+				float dy = (float)(j - y);
+				if (fabsf(dy) - 1.0f >= best) continue;
+				for (i = fons__maxi(x-r, 0); i <= fons__mini(x+r, w-1); i++) {
+					const float* pt = &pts[(i + j*w)*2];
+					float ex = i - x + pt[0], ey = dy + pt[1], d;
+					if (pt[0] > 1e5f) continue;
+					d = ex*ex + ey*ey;
+					if (d < best*best) best = sqrtf(d);
+				}
+			}
+			if (cov[x + y*w] < 128) best = -best;
+			v = 128 + (int)(best * (128.0f / FONS_SDF_SPREAD) + (best > 0.0f ? 0.5f : -0.5f));
+			dst[x + y*dstStride] = (unsigned char)fons__maxi(0, fons__mini(v, 255));
+		}
+	}
+	return 1;
+}
+
+// Returns 1 if glyphs with the blur are rasterized as distance fields.
+static int fons__sdfGlyphs(FONScontext* stash, short iblur)
+{
+	return (stash->params.flags & FONS_SDF) || ((stash->params.flags & FONS_SDF_BLUR) && iblur > 0);
+}
+
+// Maps the size and blur to the ones the glyph is rasterized at, and returns the padding around it.
+// Distance field glyphs get a negative blur, which keeps them apart from coverage glyphs.
+static int fons__rasterSize(FONScontext* stash, short* isize, short* iblur)
+{
+	int pad;
+	if (*iblur > 20) *iblur = 20;
+	if (*iblur < 0) *iblur = 0;
+	pad = *iblur+2;
+	if (fons__sdfGlyphs(stash, *iblur)) {
+		// One distance field serves all sizes and blurs.
+		*isize = FONS_SDF_SIZE*10;
+		*iblur = -1;
+		pad = FONS_SDF_SPREAD+1;
+	} else if (stash->sizeBuckets > 0) {
+		// Round the size up to the next bucket, the quads are scaled down from it.
+		float steps = (float)stash->sizeBuckets;
+		float bucket = expf(ceilf(logf(*isize/10.0f) / 0.69314718f * steps - 0.001f) / steps * 0.69314718f);
+		*isize = (short)(bucket * 10.0f + 0.5f);
+	}
+	return pad;
+}
+
+static FONSglyph* fons__findGlyph(FONSfont* font, unsigned int codepoint, short isize, short iblur)
+{
+	int i = font->lut[fons__hashint(codepoint) & (FONS_HASH_LUT_SIZE-1)];
+	while (i != -1) {
+		if (font->glyphs[i].codepoint == codepoint && font->glyphs[i].size == isize && font->glyphs[i].blur == iblur)
+			return &font->glyphs[i];
 		i = font->glyphs[i].next;
 	}
+	return NULL;
+}
 
-	// Create a new glyph or rasterize bitmap data for a cached glyph.
-	g = fons__tt_getGlyphIndex(&font->font, codepoint);
+// Returns the glyph index of the code point, and the font or fallback font which has it.
+static int fons__findGlyphIndex(FONScontext* stash, FONSfont* font, unsigned int codepoint, FONSfont** renderFont)
+{
+	int i, g = fons__tt_getGlyphIndex(&font->font, codepoint);
+	*renderFont = font;
 	// Try to find the glyph in fallback fonts.
 	if (g == 0) {
 		for (i = 0; i < font->nfallbacks; ++i) {
@@ -1093,13 +1572,96 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 			int fallbackIndex = fons__tt_getGlyphIndex(&fallbackFont->font, codepoint);
 			if (fallbackIndex != 0) {
 				g = fallbackIndex;
-				renderFont = fallbackFont;
+				*renderFont = fallbackFont;
 				break;
 			}
 		}
 		// It is possible that we did not find a fallback glyph.
 		// In that case the glyph index 'g' is 0, and we'll proceed below and cache empty glyph.
 	}
+	return g;
+}
+
+// Rasterizes the glyph into the gw x gh area at dst, inside the padding, and turns it into a
+// distance field or blurs it. Returns 0 if the scratch buffer is too small for the distance field.
+static int fons__renderGlyph(FONSttFontImpl* font, int g, float scale, int pad, int sdf, int iblur,
+							 unsigned char* dst, int gw, int gh, int stride, unsigned char* scratch, int nscratch)
+{
+	int x, y;
+
+	fons__tt_renderGlyphBitmap(font, &dst[pad + pad*stride], gw-pad*2,gh-pad*2, stride, scale, scale, g);
+
+	// Make sure there is one pixel empty border.
+	for (y = 0; y < gh; y++) {
+		dst[y*stride] = 0;
+		dst[gw-1 + y*stride] = 0;
+	}
+	for (x = 0; x < gw; x++) {
+		dst[x] = 0;
+		dst[x + (gh-1)*stride] = 0;
+	}
+
+	// Debug code to color the glyph background
+/*	for (y = 0; y < gh; y++) {
+		for (x = 0; x < gw; x++) {
+			int a = (int)dst[x+y*stride] + 20;
+			if (a > 255) a = 255;
+			dst[x+y*stride] = a;
+		}
+	}*/
+
+	if (sdf && !fons__sdf(scratch, nscratch, dst, gw, gh, stride))
+		return 0;
+
+	// Blur
+	if (iblur > 0)
+		fons__blur(NULL, dst, gw, gh, stride, iblur);
+
+	return 1;
+}
+
+// Like fons__getGlyph(), but copies the bitmap of a pre-warmed glyph instead of rasterizing it.
+static FONSglyph* fons__getGlyphFrom(FONScontext* stash, FONSfont* font, unsigned int codepoint,
+									 short isize, short iblur, int bitmapOption, const FONSprewarmGlyph* staged)
+{
+	int g, advance, lsb, x0, y0, x1, y1, gw, gh, gx, gy, y;
+	float scale;
+	FONSglyph* glyph = NULL;
+	float size;
+	int pad, page;
+	unsigned char* dst;
+	FONSfont* renderFont = font;
+
+	if (isize < 2) return NULL;
+	pad = fons__rasterSize(stash, &isize, &iblur);
+	size = isize/10.0f;
+
+	// Reset allocator.
+	stash->nscratch = 0;
+
+	// Find code point and size.
+	glyph = fons__findGlyph(font, codepoint, isize, iblur);
+	if (glyph != NULL) {
+		if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL)
+			return glyph;
+		if (glyph->x0 >= 0 && glyph->y0 >= 0) {
+			stash->pages[glyph->page].lastUsed = stash->frame;
+			return glyph;
+		}
+		// At this point, glyph exists but the bitmap data is not yet created.
+	}
+
+	if (bitmapOption == FONS_GLYPH_BITMAP_REQUIRED && staged == NULL &&
+		stash->glyphBudget > 0 && stash->nrasterized >= stash->glyphBudget) {
+		// Over the budget of this frame, cache only the metrics and let the caller draw a placeholder.
+		stash->ndeferred++;
+		if (glyph != NULL)
+			return glyph;
+		bitmapOption = FONS_GLYPH_BITMAP_OPTIONAL;
+	}
+
+	// Create a new glyph or rasterize bitmap data for a cached glyph.
+	g = fons__findGlyphIndex(stash, font, codepoint, &renderFont);
 	scale = fons__tt_getPixelHeightScale(&renderFont->font, size);
 	fons__tt_buildGlyphBitmap(&renderFont->font, g, size, scale, &advance, &lsb, &x0, &y0, &x1, &y1);
 	gw = x1-x0 + pad*2;
@@ -1108,25 +1670,30 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 	// Determines the spot to draw glyph in the atlas.
 	if (bitmapOption == FONS_GLYPH_BITMAP_REQUIRED) {
 		// Find free spot for the rect in the atlas
-		added = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy);
-		if (added == 0 && stash->handleError != NULL) {
+		page = fons__pageAddRect(stash, gw, gh, &gx, &gy);
+		if (page == -1 && stash->handleError != NULL) {
 			// Atlas is full, let the user to resize the atlas (or not), and try again.
 			stash->handleError(stash->errorUptr, FONS_ATLAS_FULL, 0);
-			added = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy);
+			page = fons__pageAddRect(stash, gw, gh, &gx, &gy);
 		}
-		if (added == 0) return NULL;
+		if (page == -1) return NULL;
+		// Keep the page from being evicted while the glyph is drawn during this frame.
+		stash->pages[page].lastUsed = stash->frame;
 	} else {
 		// Negative coordinate indicates there is no bitmap data created.
 		gx = -1;
 		gy = -1;
+		page = 0;
 	}
 
 	// Init glyph.
 	if (glyph == NULL) {
+		unsigned int h = fons__hashint(codepoint) & (FONS_HASH_LUT_SIZE-1);
 		glyph = fons__allocGlyph(font);
 		glyph->codepoint = codepoint;
 		glyph->size = isize;
 		glyph->blur = iblur;
+		glyph->prewarm = 0;
 		glyph->next = 0;
 
 		// Insert char to hash lookup.
@@ -1141,53 +1708,45 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 	glyph->xadv = (short)(scale * advance * 10.0f);
 	glyph->xoff = (short)(x0 - pad);
 	glyph->yoff = (short)(y0 - pad);
+	glyph->page = (short)page;
 
 	if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL) {
 		return glyph;
 	}
 
 	// Rasterize
-	dst = &stash->texData[(glyph->x0+pad) + (glyph->y0+pad) * stash->params.width];
-	fons__tt_renderGlyphBitmap(&renderFont->font, dst, gw-pad*2,gh-pad*2, stash->params.width, scale, scale, g);
-
-	// Make sure there is one pixel empty border.
-	dst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-	for (y = 0; y < gh; y++) {
-		dst[y*stash->params.width] = 0;
-		dst[gw-1 + y*stash->params.width] = 0;
-	}
-	for (x = 0; x < gw; x++) {
-		dst[x] = 0;
-		dst[x + (gh-1)*stash->params.width] = 0;
-	}
-
-	// Debug code to color the glyph background
-/*	unsigned char* fdst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-	for (y = 0; y < gh; y++) {
-		for (x = 0; x < gw; x++) {
-			int a = (int)fdst[x+y*stash->params.width] + 20;
-			if (a > 255) a = 255;
-			fdst[x+y*stash->params.width] = a;
+	dst = &stash->pages[page].texData[glyph->x0 + glyph->y0 * stash->params.width];
+	if (staged != NULL && staged->bitmap != NULL && staged->gw == gw && staged->gh == gh) {
+		for (y = 0; y < gh; y++)
+			memcpy(&dst[y*stash->params.width], &staged->bitmap[y*gw], gw);
+	} else {
+		stash->nrasterized++;
+		if (!fons__renderGlyph(&renderFont->font, g, scale, pad, iblur < 0, iblur,
+							   dst, gw, gh, stash->params.width, stash->scratch, FONS_SCRATCH_BUF_SIZE)) {
+			if (stash->handleError)
+				stash->handleError(stash->errorUptr, FONS_SCRATCH_FULL, fons__sdfScratchSize(gw, gh));
 		}
-	}*/
-
-	// Blur
-	if (iblur > 0) {
-		stash->nscratch = 0;
-		bdst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-		fons__blur(stash, bdst, gw, gh, stash->params.width, iblur);
 	}
 
-	stash->dirtyRect[0] = fons__mini(stash->dirtyRect[0], glyph->x0);
-	stash->dirtyRect[1] = fons__mini(stash->dirtyRect[1], glyph->y0);
-	stash->dirtyRect[2] = fons__maxi(stash->dirtyRect[2], glyph->x1);
-	stash->dirtyRect[3] = fons__maxi(stash->dirtyRect[3], glyph->y1);
+	fons__addDirtyRect(&stash->pages[page], glyph->x0, glyph->y0, glyph->x1, glyph->y1);
 
 	return glyph;
 }
 
+static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned int codepoint,
+								 short isize, short iblur, int bitmapOption)
+{
+	return fons__getGlyphFrom(stash, font, codepoint, isize, iblur, bitmapOption, NULL);
+}
+
+// Returns 1 if the quad of the glyph is scaled, instead of snapped to whole pixels.
+static int fons__scaledQuad(FONSglyph* glyph, short isize)
+{
+	return glyph->size != isize || glyph->blur < 0;
+}
+
 static void fons__getQuad(FONScontext* stash, FONSfont* font,
-						   int prevGlyphIndex, FONSglyph* glyph,
+						   int prevGlyphIndex, FONSglyph* glyph, short isize, short iblur,
 						   float scale, float spacing, float* x, float* y, FONSquad* q)
 {
 	float rx,ry,xoff,yoff,x0,y0,x1,y1;
@@ -1197,6 +1756,42 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 		*x += (int)(adv + spacing + 0.5f);
 	}
 
+	if (fons__scaledQuad(glyph, isize)) {
+		// Glyph rasterized at another size, scale it to the size and keep the subpixel position.
+		float k = (float)isize / glyph->size;
+		float inset = 1.0f;
+		// Trim the part of the distance field spread that stays empty.
+		if (glyph->blur < 0)
+			inset += FONS_SDF_SPREAD - fons__minf(FONS_SDF_SPREAD, fons__sdfWidth(iblur) * 0.5f / k + 1.0f);
+		xoff = glyph->xoff + inset;
+		yoff = glyph->yoff + inset;
+		x0 = glyph->x0 + inset;
+		y0 = glyph->y0 + inset;
+		x1 = glyph->x1 - inset;
+		y1 = glyph->y1 - inset;
+
+		rx = *x + xoff * k;
+		q->x0 = rx;
+		q->x1 = rx + (x1 - x0) * k;
+		if (stash->params.flags & FONS_ZERO_TOPLEFT) {
+			ry = *y + yoff * k;
+			q->y0 = ry;
+			q->y1 = ry + (y1 - y0) * k;
+		} else {
+			ry = *y - yoff * k;
+			q->y0 = ry;
+			q->y1 = ry - (y1 - y0) * k;
+		}
+		q->s0 = x0 * stash->itw;
+		q->t0 = y0 * stash->ith;
+		q->s1 = x1 * stash->itw;
+		q->t1 = y1 * stash->ith;
+		q->page = glyph->page;
+
+		*x += glyph->xadv / 10.0f * k;
+		return;
+	}
+
 	// Each glyph has 2px border to allow good interpolation,
 	// one pixel to prevent leaking, and one to allow good interpolation for rendering.
 	// Inset the texture region by one pixel for correct interpolation.
@@ -1235,21 +1830,50 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 		q->t1 = y1 * stash->ith;
 	}
 
+	q->page = glyph->page;
+
 	*x += (int)(glyph->xadv / 10.0f + 0.5f);
 }
 
+// Maps the quad of a glyph without bitmap to the closest size of it in the atlas, or collapses the
+// quad if there is none. The quad keeps the position and size of the glyph.
+static void fons__placeholderQuad(FONScontext* stash, FONSfont* font, FONSglyph* glyph, FONSquad* q)
+{
+	FONSglyph* best = NULL;
+	int i = font->lut[fons__hashint(glyph->codepoint) & (FONS_HASH_LUT_SIZE-1)];
+	while (i != -1) {
+		FONSglyph* other = &font->glyphs[i];
+		if (other->codepoint == glyph->codepoint && other->blur == glyph->blur && other->x0 >= 0 &&
+			(best == NULL || abs(other->size - glyph->size) < abs(best->size - glyph->size)))
+			best = other;
+		i = other->next;
+	}
+	if (best == NULL) {
+		q->x1 = q->x0;
+		q->y1 = q->y0;
+		q->s0 = q->t0 = q->s1 = q->t1 = 0.0f;
+		return;
+	}
+	stash->pages[best->page].lastUsed = stash->frame;
+	q->s0 = (best->x0+1) * stash->itw;
+	q->t0 = (best->y0+1) * stash->ith;
+	q->s1 = (best->x1-1) * stash->itw;
+	q->t1 = (best->y1-1) * stash->ith;
+	q->page = best->page;
+}
+
 static void fons__flush(FONScontext* stash)
 {
+	FONSpage* page = &stash->pages[0];
+	int i;
+
 	// Flush texture
-	if (stash->dirtyRect[0] < stash->dirtyRect[2] && stash->dirtyRect[1] < stash->dirtyRect[3]) {
-		if (stash->params.renderUpdate != NULL)
-			stash->params.renderUpdate(stash->params.userPtr, stash->dirtyRect, stash->texData);
-		// Reset dirty rect
-		stash->dirtyRect[0] = stash->params.width;
-		stash->dirtyRect[1] = stash->params.height;
-		stash->dirtyRect[2] = 0;
-		stash->dirtyRect[3] = 0;
+	if (stash->params.renderUpdate != NULL) {
+		for (i = 0; i < page->ndirty; i++)
+			stash->params.renderUpdate(stash->params.userPtr, page->dirtyRects[i], page->texData);
 	}
+	// Reset dirty rects
+	page->ndirty = 0;
 
 	// Flush triangles
 	if (stash->nverts > 0) {
@@ -1339,7 +1963,9 @@ float fonsDrawText(FONScontext* stash,
 			continue;
 		glyph = fons__getGlyph(stash, font, codepoint, isize, iblur, FONS_GLYPH_BITMAP_REQUIRED);
 		if (glyph != NULL) {
-			fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q);
+			fons__getQuad(stash, font, prevGlyphIndex, glyph, isize, iblur, scale, state->spacing, &x, &y, &q);
+			if (glyph->x0 < 0)
+				fons__placeholderQuad(stash, font, glyph, &q);
 
 			if (stash->nverts+6 > FONS_VERTEX_COUNT)
 				fons__flush(stash);
@@ -1423,8 +2049,12 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, FONSquad* quad)
 		iter->y = iter->nexty;
 		glyph = fons__getGlyph(stash, iter->font, iter->codepoint, iter->isize, iter->iblur, iter->bitmapOption);
 		// If the iterator was initialized with FONS_GLYPH_BITMAP_OPTIONAL, then the UV coordinates of the quad will be invalid.
-		if (glyph != NULL)
-			fons__getQuad(stash, iter->font, iter->prevGlyphIndex, glyph, iter->scale, iter->spacing, &iter->nextx, &iter->nexty, quad);
+		if (glyph != NULL) {
+			fons__getQuad(stash, iter->font, iter->prevGlyphIndex, glyph, iter->isize, iter->iblur, iter->scale, iter->spacing, &iter->nextx, &iter->nexty, quad);
+			if (iter->bitmapOption == FONS_GLYPH_BITMAP_REQUIRED && glyph->x0 < 0)
+				fons__placeholderQuad(stash, iter->font, glyph, quad);
+			iter->snapped = !fons__scaledQuad(glyph, iter->isize);
+		}
 		iter->prevGlyphIndex = glyph != NULL ? glyph->index : -1;
 		break;
 	}
@@ -1433,6 +2063,125 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, FONSquad* quad)
 	return 1;
 }
 
+FONSprewarm* fonsPrewarmBegin(FONScontext* stash, const unsigned int* codepoints, int n)
+{
+	FONSstate* state;
+	FONSprewarm* p = NULL;
+	FONSfont* font;
+	int i, advance, lsb, x0, y0, x1, y1;
+
+	if (stash == NULL || n <= 0) return NULL;
+	state = fons__getState(stash);
+	if (state->font < 0 || state->font >= stash->nfonts) return NULL;
+	font = stash->fonts[state->font];
+	if (font->data == NULL) return NULL;
+
+	p = (FONSprewarm*)malloc(sizeof(FONSprewarm));
+	if (p == NULL) goto error;
+	memset(p, 0, sizeof(FONSprewarm));
+	p->glyphs = (FONSprewarmGlyph*)malloc(sizeof(FONSprewarmGlyph) * n);
+	if (p->glyphs == NULL) goto error;
+
+	p->isize = p->rsize = (short)(state->size*10.0f);
+	p->iblur = p->rblur = (short)state->blur;
+	if (p->isize < 2) goto error;
+	p->pad = fons__rasterSize(stash, &p->rsize, &p->rblur);
+	p->sdf = p->rblur < 0;
+
+	for (i = 0; i < n; i++) {
+		FONSprewarmGlyph* pg;
+		// Skip glyphs in the atlas, and the ones queued already by this or an earlier batch.
+		FONSglyph* glyph = fons__getGlyph(stash, font, codepoints[i], p->isize, p->iblur, FONS_GLYPH_BITMAP_OPTIONAL);
+		if (glyph == NULL || glyph->x0 >= 0 || glyph->prewarm)
+			continue;
+		glyph->prewarm = 1;
+
+		pg = &p->glyphs[p->nglyphs++];
+		pg->font = font;
+		pg->codepoint = codepoints[i];
+		pg->index = fons__findGlyphIndex(stash, font, codepoints[i], &pg->renderFont);
+		pg->scale = fons__tt_getPixelHeightScale(&pg->renderFont->font, p->rsize/10.0f);
+		fons__tt_buildGlyphBitmap(&pg->renderFont->font, pg->index, p->rsize/10.0f, pg->scale, &advance, &lsb, &x0, &y0, &x1, &y1);
+		pg->gw = x1-x0 + p->pad*2;
+		pg->gh = y1-y0 + p->pad*2;
+		pg->bitmap = NULL;
+	}
+
+	return p;
+
+error:
+	fonsPrewarmFree(p);
+	return NULL;
+}
+
+int fonsPrewarmCount(FONSprewarm* p)
+{
+	return p != NULL ? p->nglyphs : 0;
+}
+
+void fonsPrewarmRasterize(FONSprewarm* p, int i)
+{
+#ifdef FONS_USE_FREETYPE
+	// The glyph slot of a face can not be shared between threads, fonsPrewarmEnd() rasterizes the glyph.
+	FONS_NOTUSED(p);
+	FONS_NOTUSED(i);
+#else
+	FONSprewarmGlyph* pg = &p->glyphs[i];
+	FONSttFontImpl font = pg->renderFont->font;
+	unsigned char* scratch = NULL;
+	int nscratch = 0;
+
+	// Allocate from the heap instead of the scratch buffer of the stash.
+	font.font.userdata = NULL;
+
+	pg->bitmap = (unsigned char*)calloc(pg->gw * pg->gh, 1);
+	if (pg->bitmap == NULL) return;
+	if (p->sdf) {
+		nscratch = fons__sdfScratchSize(pg->gw, pg->gh);
+		scratch = (unsigned char*)malloc(nscratch);
+		if (scratch == NULL) nscratch = 0;
+	}
+	if (!fons__renderGlyph(&font, pg->index, pg->scale, p->pad, p->sdf, p->rblur,
+						   pg->bitmap, pg->gw, pg->gh, pg->gw, scratch, nscratch)) {
+		free(pg->bitmap);
+		pg->bitmap = NULL;
+	}
+	if (scratch != NULL) free(scratch);
+#endif
+}
+
+int fonsPrewarmEnd(FONScontext* stash, FONSprewarm* p)
+{
+	int i, n = 0;
+	if (stash == NULL || p == NULL) return 0;
+
+	// Glyphs which could not be rasterized ahead are rasterized here.
+	for (i = 0; i < p->nglyphs; i++) {
+		FONSprewarmGlyph* pg = &p->glyphs[i];
+		FONSglyph* glyph;
+		if (fons__getGlyphFrom(stash, pg->font, pg->codepoint, p->isize, p->iblur, FONS_GLYPH_BITMAP_REQUIRED, pg) != NULL)
+			n++;
+		glyph = fons__findGlyph(pg->font, pg->codepoint, p->rsize, p->rblur);
+		if (glyph != NULL)
+			glyph->prewarm = 0;
+	}
+
+	fonsPrewarmFree(p);
+	return n;
+}
+
+void fonsPrewarmFree(FONSprewarm* p)
+{
+	int i;
+	if (p == NULL) return;
+	if (p->glyphs != NULL) {
+		for (i = 0; i < p->nglyphs; i++)
+			if (p->glyphs[i].bitmap != NULL) free(p->glyphs[i].bitmap);
+		free(p->glyphs);
+	}
+	free(p);
+}
+
 void fonsDrawDebug(FONScontext* stash, float x, float y)
 {
 	int i;
@@ -1463,8 +2212,8 @@ void fonsDrawDebug(FONScontext* stash, float x, float y)
 	fons__vertex(stash, x+w, y+h, 1, 1, 0xffffffff);
 
 	// Drawbug draw atlas
-	for (i = 0; i < stash->atlas->nnodes; i++) {
-		FONSatlasNode* n = &stash->atlas->nodes[i];
+	for (i = 0; i < stash->pages[0].atlas->nnodes; i++) {
+		FONSatlasNode* n = &stash->pages[0].atlas->nodes[i];
 
 		if (stash->nverts+6 > FONS_VERTEX_COUNT)
 			fons__flush(stash);
@@ -1521,7 +2270,7 @@ float fonsTextBounds(FONScontext* stash,
 			continue;
 		glyph = fons__getGlyph(stash, font, codepoint, isize, iblur, FONS_GLYPH_BITMAP_OPTIONAL);
 		if (glyph != NULL) {
-			fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q);
+			fons__getQuad(stash, font, prevGlyphIndex, glyph, isize, iblur, scale, state->spacing, &x, &y, &q);
 			if (q.x0 < minx) minx = q.x0;
 			if (q.x1 > maxx) maxx = q.x1;
 			if (stash->params.flags & FONS_ZERO_TOPLEFT) {
@@ -1603,29 +2352,114 @@ void fonsLineBounds(FONScontext* stash, float y, float* miny, float* maxy)
 }
 
 const unsigned char* fonsGetTextureData(FONScontext* stash, int* width, int* height)
+{
+	return fonsGetPageData(stash, 0, width, height);
+}
+
+int fonsValidateTexture(FONScontext* stash, int* dirty)
+{
+	return fonsValidatePage(stash, 0, dirty);
+}
+
+int fonsGetPageCount(FONScontext* stash)
+{
+	return stash->npages;
+}
+
+const unsigned char* fonsGetPageData(FONScontext* stash, int page, int* width, int* height)
 {
 	if (width != NULL)
 		*width = stash->params.width;
 	if (height != NULL)
 		*height = stash->params.height;
-	return stash->texData;
+	return stash->pages[page].texData;
 }
 
-int fonsValidateTexture(FONScontext* stash, int* dirty)
+int fonsValidatePage(FONScontext* stash, int page, int* dirty)
 {
-	if (stash->dirtyRect[0] < stash->dirtyRect[2] && stash->dirtyRect[1] < stash->dirtyRect[3]) {
-		dirty[0] = stash->dirtyRect[0];
-		dirty[1] = stash->dirtyRect[1];
-		dirty[2] = stash->dirtyRect[2];
-		dirty[3] = stash->dirtyRect[3];
-		// Reset dirty rect
-		stash->dirtyRect[0] = stash->params.width;
-		stash->dirtyRect[1] = stash->params.height;
-		stash->dirtyRect[2] = 0;
-		stash->dirtyRect[3] = 0;
-		return 1;
+	int i, rects[FONS_MAX_DIRTY_RECTS*4];
+	int n = fonsValidatePageRects(stash, page, rects);
+	if (n == 0)
+		return 0;
+	// Report the union of the changed regions.
+	dirty[0] = rects[0];
+	dirty[1] = rects[1];
+	dirty[2] = rects[2];
+	dirty[3] = rects[3];
+	for (i = 1; i < n; i++) {
+		dirty[0] = fons__mini(dirty[0], rects[i*4+0]);
+		dirty[1] = fons__mini(dirty[1], rects[i*4+1]);
+		dirty[2] = fons__maxi(dirty[2], rects[i*4+2]);
+		dirty[3] = fons__maxi(dirty[3], rects[i*4+3]);
+	}
+	return 1;
+}
+
+int fonsValidatePageRects(FONScontext* stash, int page, int* rects)
+{
+	FONSpage* p = &stash->pages[page];
+	int n = p->ndirty;
+	memcpy(rects, p->dirtyRects, sizeof(int)*4*n);
+	// Reset dirty rects
+	p->ndirty = 0;
+	return n;
+}
+
+int fonsGetSDFParams(FONScontext* stash, float* edge, float* scale)
+{
+	FONSstate* state = fons__getState(stash);
+	float k = state->size / FONS_SDF_SIZE;
+	if (!fons__sdfGlyphs(stash, (short)state->blur))
+		return 0;
+	*edge = 128.0f / 255.0f;
+	// Keep the coverage zero where the field ends, this limits the blur to the spread.
+	*scale = fons__maxf(255.0f * FONS_SDF_SPREAD * k / (128.0f * fons__sdfWidth(state->blur)), 0.5f / *edge);
+	return 1;
+}
+
+void fonsSetSizeBuckets(FONScontext* stash, int steps)
+{
+	if (stash == NULL) return;
+	if (stash->sizeBuckets != steps)
+		stash->generation++;
+	stash->sizeBuckets = steps;
+}
+
+void fonsSetGlyphBudget(FONScontext* stash, int glyphs)
+{
+	if (stash == NULL) return;
+	stash->glyphBudget = glyphs;
+}
+
+void fonsGetGlyphStats(FONScontext* stash, int* rasterized, int* deferred)
+{
+	if (stash == NULL) return;
+	if (rasterized != NULL) *rasterized = stash->nrasterized;
+	if (deferred != NULL) *deferred = stash->ndeferred;
+}
+
+void fonsBeginFrame(FONScontext* stash)
+{
+	if (stash == NULL) return;
+	stash->frame++;
+	stash->nrasterized = 0;
+	stash->ndeferred = 0;
+}
+
+int fonsGetAtlasGeneration(FONScontext* stash)
+{
+	if (stash == NULL) return 0;
+	return stash->generation;
+}
+
+void fonsTouchPages(FONScontext* stash, unsigned int pages)
+{
+	int i;
+	if (stash == NULL) return;
+	for (i = 0; i < stash->npages; i++) {
+		if (pages & (1u << i))
+			stash->pages[i].lastUsed = stash->frame;
 	}
-	return 0;
 }
 
 void fonsDeleteInternal(FONScontext* stash)
@@ -1639,9 +2473,11 @@ void fonsDeleteInternal(FONScontext* stash)
 	for (i = 0; i < stash->nfonts; ++i)
 		fons__freeFont(stash->fonts[i]);
 
-	if (stash->atlas) fons__deleteAtlas(stash->atlas);
+	for (i = 0; i < FONS_MAX_PAGES; i++) {
+		if (stash->pages[i].atlas) fons__deleteAtlas(stash->pages[i].atlas);
+		if (stash->pages[i].texData) free(stash->pages[i].texData);
+	}
 	if (stash->fonts) free(stash->fonts);
-	if (stash->texData) free(stash->texData);
 	if (stash->scratch) free(stash->scratch);
 	free(stash);
 	fons__tt_done(stash);
@@ -1663,7 +2499,7 @@ void fonsGetAtlasSize(FONScontext* stash, int* width, int* height)
 
 int fonsExpandAtlas(FONScontext* stash, int width, int height)
 {
-	int i, maxy = 0;
+	int i, j, maxy;
 	unsigned char* data = NULL;
 	if (stash == NULL) return 0;
 
@@ -1681,38 +2517,43 @@ int fonsExpandAtlas(FONScontext* stash, int width, int height)
 		if (stash->params.renderResize(stash->params.userPtr, width, height) == 0)
 			return 0;
 	}
-	// Copy old texture data over.
-	data = (unsigned char*)malloc(width * height);
-	if (data == NULL)
-		return 0;
-	for (i = 0; i < stash->params.height; i++) {
-		unsigned char* dst = &data[i*width];
-		unsigned char* src = &stash->texData[i*stash->params.width];
-		memcpy(dst, src, stash->params.width);
-		if (width > stash->params.width)
-			memset(dst+stash->params.width, 0, width - stash->params.width);
-	}
-	if (height > stash->params.height)
-		memset(&data[stash->params.height * width], 0, (height - stash->params.height) * width);
-
-	free(stash->texData);
-	stash->texData = data;
-
-	// Increase atlas size
-	fons__atlasExpand(stash->atlas, width, height);
-
-	// Add existing data as dirty.
-	for (i = 0; i < stash->atlas->nnodes; i++)
-		maxy = fons__maxi(maxy, stash->atlas->nodes[i].y);
-	stash->dirtyRect[0] = 0;
-	stash->dirtyRect[1] = 0;
-	stash->dirtyRect[2] = stash->params.width;
-	stash->dirtyRect[3] = maxy;
+	for (j = 0; j < stash->npages; j++) {
+		FONSpage* page = &stash->pages[j];
+
+		// Copy old texture data over.
+		data = (unsigned char*)malloc(width * height);
+		if (data == NULL)
+			return 0;
+		for (i = 0; i < stash->params.height; i++) {
+			unsigned char* dst = &data[i*width];
+			unsigned char* src = &page->texData[i*stash->params.width];
+			memcpy(dst, src, stash->params.width);
+			if (width > stash->params.width)
+				memset(dst+stash->params.width, 0, width - stash->params.width);
+		}
+		if (height > stash->params.height)
+			memset(&data[stash->params.height * width], 0, (height - stash->params.height) * width);
+
+		free(page->texData);
+		page->texData = data;
+
+		// Increase atlas size
+		fons__atlasExpand(page->atlas, width, height);
+
+		// Add existing data as dirty.
+		maxy = 0;
+		for (i = 0; i < page->atlas->nnodes; i++)
+			maxy = fons__maxi(maxy, page->atlas->nodes[i].y);
+		page->ndirty = 0;
+		if (maxy > 0)
+			fons__addDirtyRect(page, 0, 0, stash->params.width, maxy);
+	}
 
 	stash->params.width = width;
 	stash->params.height = height;
 	stash->itw = 1.0f/stash->params.width;
 	stash->ith = 1.0f/stash->params.height;
+	stash->generation++;
 
 	return 1;
 }
@@ -1731,19 +2572,17 @@ int fonsResetAtlas(FONScontext* stash, int width, int height)
 			return 0;
 	}
 
-	// Reset atlas
-	fons__atlasReset(stash->atlas, width, height);
-
-	// Clear texture data.
-	stash->texData = (unsigned char*)realloc(stash->texData, width * height);
-	if (stash->texData == NULL) return 0;
-	memset(stash->texData, 0, width * height);
+	stash->params.width = width;
+	stash->params.height = height;
+	stash->itw = 1.0f/stash->params.width;
+	stash->ith = 1.0f/stash->params.height;
+	stash->generation++;
 
-	// Reset dirty rect
-	stash->dirtyRect[0] = width;
-	stash->dirtyRect[1] = height;
-	stash->dirtyRect[2] = 0;
-	stash->dirtyRect[3] = 0;
+	// Reset atlas pages
+	for (i = 0; i < stash->npages; i++) {
+		if (!fons__resetPage(stash, &stash->pages[i]))
+			return 0;
+	}
 
 	// Reset cached glyphs
 	for (i = 0; i < stash->nfonts; i++) {
@@ -1753,14 +2592,6 @@ int fonsResetAtlas(FONScontext* stash, int width, int height)
 			font->lut[j] = -1;
 	}
 
-	stash->params.width = width;
-	stash->params.height = height;
-	stash->itw = 1.0f/stash->params.width;
-	stash->ith = 1.0f/stash->params.height;
-
-	// Add white rect at 0,0 for debug drawing.
-	fons__addWhiteRect(stash, 2,2);
-
 	return 1;
 }
 
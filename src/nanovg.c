@@ -21,7 +21,17 @@
 #include <math.h>
 #include <memory.h>
 
+#ifndef NVG_NO_THREADS
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
 #include "nanovg.h"
+#define FONS_MAX_PAGES 4
 #define FONTSTASH_IMPLEMENTATION
 #include "fontstash.h"
 #define STB_IMAGE_IMPLEMENTATION
@@ -34,20 +44,72 @@
 #pragma warning(disable: 4706)  // assignment within conditional expression
 #endif
 
-#define NVG_INIT_FONTIMAGE_SIZE  512
-#define NVG_MAX_FONTIMAGE_SIZE   2048
-#define NVG_MAX_FONTIMAGES       4
+#define NVG_FONTIMAGE_SIZE       1024
+#define NVG_MAX_FONTIMAGES       FONS_MAX_PAGES	// One texture per font atlas page.
+#define NVG_TEXT_RUNS            256	// Number of cached text runs, power of two.
+#define NVG_PREWARM_THREADS      4	// Worker threads rasterizing pre-warmed glyphs.
 
 #define NVG_INIT_COMMANDS_SIZE 256
 #define NVG_INIT_POINTS_SIZE 128
 #define NVG_INIT_PATHS_SIZE 16
 #define NVG_INIT_VERTS_SIZE 256
 #define NVG_MAX_STATES 32
+#define NVG_MAX_DASHES 16
+#define NVG_MAX_TRIANGULATE 256	// Max points of a path that is triangulated for fills.
 
 #define NVG_KAPPA90 0.5522847493f	// Length proportional to radius of a cubic bezier handle for 90deg arcs.
 
 #define NVG_COUNTOF(arr) (sizeof(arr) / sizeof(0[arr]))
 
+// Threads for pre-warming glyphs. With NVG_NO_THREADS no thread is started and the glyphs are
+// rasterized on the calling thread.
+#if defined(NVG_NO_THREADS)
+typedef int NVGthread;
+typedef int NVGmutex;
+typedef int NVGcond;
+static void nvg__mutexInit(NVGmutex* m) { NVG_NOTUSED(m); }
+static void nvg__mutexDestroy(NVGmutex* m) { NVG_NOTUSED(m); }
+static void nvg__lock(NVGmutex* m) { NVG_NOTUSED(m); }
+static void nvg__unlock(NVGmutex* m) { NVG_NOTUSED(m); }
+static void nvg__condInit(NVGcond* c) { NVG_NOTUSED(c); }
+static void nvg__condDestroy(NVGcond* c) { NVG_NOTUSED(c); }
+static void nvg__condBroadcast(NVGcond* c) { NVG_NOTUSED(c); }
+static int nvg__threadStart(NVGthread* t, NVGcontext* ctx) { NVG_NOTUSED(t); NVG_NOTUSED(ctx); return 0; }
+static void nvg__threadJoin(NVGthread t) { NVG_NOTUSED(t); }
+#elif defined(_WIN32)
+static void nvg__prewarmWork(NVGcontext* ctx);
+typedef HANDLE NVGthread;
+typedef CRITICAL_SECTION NVGmutex;
+typedef CONDITION_VARIABLE NVGcond;
+static void nvg__mutexInit(NVGmutex* m) { InitializeCriticalSection(m); }
+static void nvg__mutexDestroy(NVGmutex* m) { DeleteCriticalSection(m); }
+static void nvg__lock(NVGmutex* m) { EnterCriticalSection(m); }
+static void nvg__unlock(NVGmutex* m) { LeaveCriticalSection(m); }
+static void nvg__condInit(NVGcond* c) { InitializeConditionVariable(c); }
+static void nvg__condDestroy(NVGcond* c) { NVG_NOTUSED(c); }
+static void nvg__condWait(NVGcond* c, NVGmutex* m) { SleepConditionVariableCS(c, m, INFINITE); }
+static void nvg__condBroadcast(NVGcond* c) { WakeAllConditionVariable(c); }
+static DWORD WINAPI nvg__threadMain(LPVOID ctx) { nvg__prewarmWork((NVGcontext*)ctx); return 0; }
+static int nvg__threadStart(NVGthread* t, NVGcontext* ctx) { *t = CreateThread(NULL, 0, nvg__threadMain, ctx, 0, NULL); return *t != NULL; }
+static void nvg__threadJoin(NVGthread t) { WaitForSingleObject(t, INFINITE); CloseHandle(t); }
+#else
+static void nvg__prewarmWork(NVGcontext* ctx);
+typedef pthread_t NVGthread;
+typedef pthread_mutex_t NVGmutex;
+typedef pthread_cond_t NVGcond;
+static void nvg__mutexInit(NVGmutex* m) { pthread_mutex_init(m, NULL); }
+static void nvg__mutexDestroy(NVGmutex* m) { pthread_mutex_destroy(m); }
+static void nvg__lock(NVGmutex* m) { pthread_mutex_lock(m); }
+static void nvg__unlock(NVGmutex* m) { pthread_mutex_unlock(m); }
+static void nvg__condInit(NVGcond* c) { pthread_cond_init(c, NULL); }
+static void nvg__condDestroy(NVGcond* c) { pthread_cond_destroy(c); }
+static void nvg__condWait(NVGcond* c, NVGmutex* m) { pthread_cond_wait(c, m); }
+static void nvg__condBroadcast(NVGcond* c) { pthread_cond_broadcast(c); }
+static void* nvg__threadMain(void* ctx) { nvg__prewarmWork((NVGcontext*)ctx); return NULL; }
+static int nvg__threadStart(NVGthread* t, NVGcontext* ctx) { return pthread_create(t, NULL, nvg__threadMain, ctx) == 0; }
+static void nvg__threadJoin(NVGthread t) { pthread_join(t, NULL); }
+#endif
+
 
 enum NVGcommands {
 	NVG_MOVETO = 0,
@@ -63,17 +125,22 @@ enum NVGpointFlags
 	NVG_PT_LEFT = 0x02,
 	NVG_PT_BEVEL = 0x04,
 	NVG_PR_INNERBEVEL = 0x08,
+	NVG_PT_CHORD = 0x10,	// The segment to the next point is the chord of a curve.
 };
 
 struct NVGstate {
 	NVGcompositeOperationState compositeOperation;
 	int shapeAntiAlias;
+	int shapeClipping;
 	NVGpaint fill;
 	NVGpaint stroke;
 	float strokeWidth;
 	float miterLimit;
 	int lineJoin;
 	int lineCap;
+	float dashes[NVG_MAX_DASHES];
+	int ndashes;
+	float dashOffset;
 	float alpha;
 	float xform[6];
 	NVGscissor scissor;
@@ -105,16 +172,55 @@ struct NVGpathCache {
 	NVGvertex* verts;
 	int nverts;
 	int cverts;
+	NVGpoint* clip;
+	int cclip;
+	NVGvertex* curves;
+	int ncurves;
+	int ccurves;
+	int* indices;
+	int cindices;
+	NVGpath** order;
+	int corder;
 	float bounds[4];
 };
 typedef struct NVGpathCache NVGpathCache;
 
+// Glyph quads of a string relative to its pen origin, drawn again without font work
+// as long as the atlas generation matches.
+struct NVGtextRun {
+	char* str;
+	int len;
+	int cstr;
+	unsigned int hash;
+	int fontId;
+	float size, spacing, blur;
+	int generation;		// Atlas generation of the quads, -1 if they are not valid.
+	int snapped;		// Quads are snapped to whole pixels when positioned.
+	unsigned int pages;	// Mask of the atlas pages used by the quads.
+	float advance;
+	FONSquad* quads;
+	int nquads;
+	int cquads;
+};
+typedef struct NVGtextRun NVGtextRun;
+
+// Glyphs queued by nvgPrewarmGlyphs(), packed into the atlas once all are rasterized.
+struct NVGprewarm {
+	FONSprewarm* glyphs;
+	int next;		// Next glyph to rasterize.
+	int done;		// Number of rasterized glyphs.
+	struct NVGprewarm* link;
+};
+typedef struct NVGprewarm NVGprewarm;
+
 struct NVGcontext {
 	NVGparams params;
 	float* commands;
 	int ccommands;
 	int ncommands;
 	float commandx, commandy;
+	NVGshape shape;
+	int shapeCommands;
 	NVGstate states[NVG_MAX_STATES];
 	int nstates;
 	NVGpathCache* cache;
@@ -124,11 +230,31 @@ struct NVGcontext {
 	float devicePxRatio;
 	struct FONScontext* fs;
 	int fontImages[NVG_MAX_FONTIMAGES];
-	int fontImageIdx;
+	int fontImageFlags;
+	NVGtextRun textRuns[NVG_TEXT_RUNS];
+	NVGvertex* textVerts;	// Pending text triangles, drawn with one call while the paint stays the same.
+	int ntextVerts;
+	int ctextVerts;
+	NVGpaint textPaint;
+	NVGcompositeOperationState textCompositeOperation;
+	NVGscissor textScissor;
+	NVGprewarm* prewarms;
+	NVGthread threads[NVG_PREWARM_THREADS];
+	int nthreads;
+	NVGmutex prewarmLock;	// Guards the queue and the counters of the batches.
+	NVGcond prewarmCond;
+	int prewarmQuit;
+	float viewWidth, viewHeight;
 	int drawCallCount;
 	int fillTriCount;
 	int strokeTriCount;
 	int textTriCount;
+	int culledFillCount;
+	int culledStrokeCount;
+	int culledGlyphCount;
+	float roundWidth, roundTol;
+	int roundDivs;
+	float roundCos, roundSin;
 };
 
 static float nvg__sqrtf(float a) { return sqrtf(a); }
@@ -138,6 +264,7 @@ static float nvg__cosf(float a) { return cosf(a); }
 static float nvg__tanf(float a) { return tanf(a); }
 static float nvg__atan2f(float a,float b) { return atan2f(a, b); }
 static float nvg__acosf(float a) { return acosf(a); }
+static float nvg__cbrtf(float a) { return powf(a, 1.0f/3.0f); }
 
 static int nvg__mini(int a, int b) { return a < b ? a : b; }
 static int nvg__maxi(int a, int b) { return a > b ? a : b; }
@@ -167,6 +294,10 @@ static void nvg__deletePathCache(NVGpathCache* c)
 	if (c->points != NULL) free(c->points);
 	if (c->paths != NULL) free(c->paths);
 	if (c->verts != NULL) free(c->verts);
+	if (c->clip != NULL) free(c->clip);
+	if (c->curves != NULL) free(c->curves);
+	if (c->indices != NULL) free(c->indices);
+	if (c->order != NULL) free(c->order);
 	free(c);
 }
 
@@ -290,10 +421,14 @@ NVGcontext* nvgCreateInternal(NVGparams* params)
 	int i;
 	if (ctx == NULL) goto error;
 	memset(ctx, 0, sizeof(NVGcontext));
+	nvg__mutexInit(&ctx->prewarmLock);
+	nvg__condInit(&ctx->prewarmCond);
 
 	ctx->params = *params;
 	for (i = 0; i < NVG_MAX_FONTIMAGES; i++)
 		ctx->fontImages[i] = 0;
+	for (i = 0; i < NVG_TEXT_RUNS; i++)
+		ctx->textRuns[i].generation = -1;
 
 	ctx->commands = (float*)malloc(sizeof(float)*NVG_INIT_COMMANDS_SIZE);
 	if (!ctx->commands) goto error;
@@ -312,9 +447,16 @@ NVGcontext* nvgCreateInternal(NVGparams* params)
 
 	// Init font rendering
 	memset(&fontParams, 0, sizeof(fontParams));
-	fontParams.width = NVG_INIT_FONTIMAGE_SIZE;
-	fontParams.height = NVG_INIT_FONTIMAGE_SIZE;
+	fontParams.width = NVG_FONTIMAGE_SIZE;
+	fontParams.height = NVG_FONTIMAGE_SIZE;
 	fontParams.flags = FONS_ZERO_TOPLEFT;
+	if (ctx->params.sdfText) {
+		fontParams.flags |= FONS_SDF;
+		ctx->fontImageFlags = NVG_IMAGE_SDF;
+	} else if (ctx->params.sdfBlur) {
+		fontParams.flags |= FONS_SDF_BLUR;
+		ctx->fontImageFlags = NVG_IMAGE_SDF;
+	}
 	fontParams.renderCreate = NULL;
 	fontParams.renderUpdate = NULL;
 	fontParams.renderDraw = NULL;
@@ -324,9 +466,8 @@ NVGcontext* nvgCreateInternal(NVGparams* params)
 	if (ctx->fs == NULL) goto error;
 
 	// Create font texture
-	ctx->fontImages[0] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, fontParams.width, fontParams.height, 0, NULL);
+	ctx->fontImages[0] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, fontParams.width, fontParams.height, ctx->fontImageFlags, NULL);
 	if (ctx->fontImages[0] == 0) goto error;
-	ctx->fontImageIdx = 0;
 
 	return ctx;
 
@@ -347,9 +488,31 @@ void nvgDeleteInternal(NVGcontext* ctx)
 	if (ctx->commands != NULL) free(ctx->commands);
 	if (ctx->cache != NULL) nvg__deletePathCache(ctx->cache);
 
+	// Stop the workers before the font stash goes away.
+	nvg__lock(&ctx->prewarmLock);
+	ctx->prewarmQuit = 1;
+	nvg__condBroadcast(&ctx->prewarmCond);
+	nvg__unlock(&ctx->prewarmLock);
+	for (i = 0; i < ctx->nthreads; i++)
+		nvg__threadJoin(ctx->threads[i]);
+	while (ctx->prewarms != NULL) {
+		NVGprewarm* p = ctx->prewarms;
+		ctx->prewarms = p->link;
+		fonsPrewarmFree(p->glyphs);
+		free(p);
+	}
+	nvg__condDestroy(&ctx->prewarmCond);
+	nvg__mutexDestroy(&ctx->prewarmLock);
+
 	if (ctx->fs)
 		fonsDeleteInternal(ctx->fs);
 
+	for (i = 0; i < NVG_TEXT_RUNS; i++) {
+		if (ctx->textRuns[i].str != NULL) free(ctx->textRuns[i].str);
+		if (ctx->textRuns[i].quads != NULL) free(ctx->textRuns[i].quads);
+	}
+	if (ctx->textVerts != NULL) free(ctx->textVerts);
+
 	for (i = 0; i < NVG_MAX_FONTIMAGES; i++) {
 		if (ctx->fontImages[i] != 0) {
 			nvgDeleteImage(ctx, ctx->fontImages[i]);
@@ -363,6 +526,8 @@ void nvgDeleteInternal(NVGcontext* ctx)
 	free(ctx);
 }
 
+static void nvg__packPrewarmed(NVGcontext* ctx);
+
 void nvgBeginFrame(NVGcontext* ctx, float windowWidth, float windowHeight, float devicePixelRatio)
 {
 /*	printf("Tris: draws:%d  fill:%d  stroke:%d  text:%d  TOT:%d\n",
@@ -376,46 +541,50 @@ void nvgBeginFrame(NVGcontext* ctx, float windowWidth, float windowHeight, float
 	nvg__setDevicePixelRatio(ctx, devicePixelRatio);
 
 	ctx->params.renderViewport(ctx->params.userPtr, windowWidth, windowHeight, devicePixelRatio);
+	ctx->viewWidth = windowWidth;
+	ctx->viewHeight = windowHeight;
+
+	fonsBeginFrame(ctx->fs);
+	ctx->ntextVerts = 0;
+	nvg__packPrewarmed(ctx);
 
 	ctx->drawCallCount = 0;
 	ctx->fillTriCount = 0;
 	ctx->strokeTriCount = 0;
 	ctx->textTriCount = 0;
+	ctx->culledFillCount = 0;
+	ctx->culledStrokeCount = 0;
+	ctx->culledGlyphCount = 0;
 }
 
+static void nvg__flushText(NVGcontext* ctx);
+static void nvg__flushTextTexture(NVGcontext* ctx);
+
 void nvgCancelFrame(NVGcontext* ctx)
 {
+	ctx->ntextVerts = 0;
 	ctx->params.renderCancel(ctx->params.userPtr);
 }
 
 void nvgEndFrame(NVGcontext* ctx)
 {
+	nvg__flushText(ctx);
+	// Upload the glyphs rasterized during the frame, before the renderer draws any text.
+	nvg__flushTextTexture(ctx);
 	ctx->params.renderFlush(ctx->params.userPtr);
-	if (ctx->fontImageIdx != 0) {
-		int fontImage = ctx->fontImages[ctx->fontImageIdx];
-		int i, j, iw, ih;
-		// delete images that smaller than current one
-		if (fontImage == 0)
-			return;
-		nvgImageSize(ctx, fontImage, &iw, &ih);
-		for (i = j = 0; i < ctx->fontImageIdx; i++) {
-			if (ctx->fontImages[i] != 0) {
-				int nw, nh;
-				nvgImageSize(ctx, ctx->fontImages[i], &nw, &nh);
-				if (nw < iw || nh < ih)
-					nvgDeleteImage(ctx, ctx->fontImages[i]);
-				else
-					ctx->fontImages[j++] = ctx->fontImages[i];
-			}
-		}
-		// make current font image to first
-		ctx->fontImages[j++] = ctx->fontImages[0];
-		ctx->fontImages[0] = fontImage;
-		ctx->fontImageIdx = 0;
-		// clear all images after j
-		for (i = j; i < NVG_MAX_FONTIMAGES; i++)
-			ctx->fontImages[i] = 0;
-	}
+}
+
+void nvgFrameStats(NVGcontext* ctx, NVGframeStats* stats)
+{
+	if (stats == NULL) return;
+	stats->drawCallCount = ctx->drawCallCount;
+	stats->fillTriCount = ctx->fillTriCount;
+	stats->strokeTriCount = ctx->strokeTriCount;
+	stats->textTriCount = ctx->textTriCount;
+	stats->culledFillCount = ctx->culledFillCount;
+	stats->culledStrokeCount = ctx->culledStrokeCount;
+	stats->culledGlyphCount = ctx->culledGlyphCount;
+	fonsGetGlyphStats(ctx->fs, &stats->rasterizedGlyphCount, &stats->deferredGlyphCount);
 }
 
 NVGcolor nvgRGB(unsigned char r, unsigned char g, unsigned char b)
@@ -672,6 +841,12 @@ void nvgShapeAntiAlias(NVGcontext* ctx, int enabled)
 	state->shapeAntiAlias = enabled;
 }
 
+void nvgShapeClipping(NVGcontext* ctx, int enabled)
+{
+	NVGstate* state = nvg__getState(ctx);
+	state->shapeClipping = enabled;
+}
+
 void nvgStrokeWidth(NVGcontext* ctx, float width)
 {
 	NVGstate* state = nvg__getState(ctx);
@@ -696,6 +871,38 @@ void nvgLineJoin(NVGcontext* ctx, int join)
 	state->lineJoin = join;
 }
 
+void nvgLineDash(NVGcontext* ctx, const float* pattern, int n, float offset)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float total = 0.0f;
+	int i;
+
+	state->ndashes = 0;
+	state->dashOffset = offset;
+	if (pattern == NULL || n <= 0) return;
+
+	// Odd patterns are repeated to make them even.
+	if (n & 1) {
+		if (n*2 > NVG_MAX_DASHES) return;
+		for (i = 0; i < n*2; i++)
+			state->dashes[i] = pattern[i % n];
+		n *= 2;
+	} else {
+		if (n > NVG_MAX_DASHES) return;
+		for (i = 0; i < n; i++)
+			state->dashes[i] = pattern[i];
+	}
+
+	// Ignore invalid patterns.
+	for (i = 0; i < n; i++) {
+		if (state->dashes[i] < 0.0f) return;
+		total += state->dashes[i];
+	}
+	if (total <= 0.0f) return;
+
+	state->ndashes = n;
+}
+
 void nvgGlobalAlpha(NVGcontext* ctx, float alpha)
 {
 	NVGstate* state = nvg__getState(ctx);
@@ -1128,6 +1335,7 @@ static void nvg__clearPathCache(NVGcontext* ctx)
 {
 	ctx->cache->npoints = 0;
 	ctx->cache->npaths = 0;
+	ctx->cache->ncurves = 0;
 }
 
 static NVGpath* nvg__lastPath(NVGcontext* ctx)
@@ -1318,6 +1526,52 @@ static void nvg__tesselateBezier(NVGcontext* ctx,
 	nvg__tesselateBezier(ctx, x1234,y1234, x234,y234, x34,y34, x4,y4, level+1, type);
 }
 
+static int nvg__outsideRect(const float* bounds, const float* rect, float margin)
+{
+	return bounds[2] + margin < rect[0] || bounds[0] - margin > rect[2] ||
+		   bounds[3] + margin < rect[1] || bounds[1] - margin > rect[3];
+}
+
+static void nvg__calculateSegments(NVGcontext* ctx)
+{
+	NVGpathCache* cache = ctx->cache;
+	NVGpoint* p0;
+	NVGpoint* p1;
+	NVGpoint* pts;
+	NVGpath* path;
+	int i, j;
+
+	cache->bounds[0] = cache->bounds[1] = 1e6f;
+	cache->bounds[2] = cache->bounds[3] = -1e6f;
+
+	// Calculate the direction and length of line segments.
+	for (j = 0; j < cache->npaths; j++) {
+		path = &cache->paths[j];
+		pts = &cache->points[path->first];
+		p0 = &pts[path->count-1];
+		p1 = &pts[0];
+		path->bounds[0] = path->bounds[1] = 1e6f;
+		path->bounds[2] = path->bounds[3] = -1e6f;
+		for(i = 0; i < path->count; i++) {
+			// Calculate segment direction and length
+			p0->dx = p1->x - p0->x;
+			p0->dy = p1->y - p0->y;
+			p0->len = nvg__normalize(&p0->dx, &p0->dy);
+			// Update bounds
+			path->bounds[0] = nvg__minf(path->bounds[0], p0->x);
+			path->bounds[1] = nvg__minf(path->bounds[1], p0->y);
+			path->bounds[2] = nvg__maxf(path->bounds[2], p0->x);
+			path->bounds[3] = nvg__maxf(path->bounds[3], p0->y);
+			// Advance
+			p0 = p1++;
+		}
+		cache->bounds[0] = nvg__minf(cache->bounds[0], path->bounds[0]);
+		cache->bounds[1] = nvg__minf(cache->bounds[1], path->bounds[1]);
+		cache->bounds[2] = nvg__maxf(cache->bounds[2], path->bounds[2]);
+		cache->bounds[3] = nvg__maxf(cache->bounds[3], path->bounds[3]);
+	}
+}
+
 static void nvg__flattenPaths(NVGcontext* ctx)
 {
 	NVGpathCache* cache = ctx->cache;
@@ -1375,10 +1629,6 @@ static void nvg__flattenPaths(NVGcontext* ctx)
 		}
 	}
 
-	cache->bounds[0] = cache->bounds[1] = 1e6f;
-	cache->bounds[2] = cache->bounds[3] = -1e6f;
-
-	// Calculate the direction and length of line segments.
 	for (j = 0; j < cache->npaths; j++) {
 		path = &cache->paths[j];
 		pts = &cache->points[path->first];
@@ -1388,7 +1638,6 @@ static void nvg__flattenPaths(NVGcontext* ctx)
 		p1 = &pts[0];
 		if (nvg__ptEquals(p0->x,p0->y, p1->x,p1->y, ctx->distTol)) {
 			path->count--;
-			p0 = &pts[path->count-1];
 			path->closed = 1;
 		}
 
@@ -1400,147 +1649,656 @@ static void nvg__flattenPaths(NVGcontext* ctx)
 			if (path->winding == NVG_CW && area > 0.0f)
 				nvg__polyReverse(pts, path->count);
 		}
-
-		for(i = 0; i < path->count; i++) {
-			// Calculate segment direction and length
-			p0->dx = p1->x - p0->x;
-			p0->dy = p1->y - p0->y;
-			p0->len = nvg__normalize(&p0->dx, &p0->dy);
-			// Update bounds
-			cache->bounds[0] = nvg__minf(cache->bounds[0], p0->x);
-			cache->bounds[1] = nvg__minf(cache->bounds[1], p0->y);
-			cache->bounds[2] = nvg__maxf(cache->bounds[2], p0->x);
-			cache->bounds[3] = nvg__maxf(cache->bounds[3], p0->y);
-			// Advance
-			p0 = p1++;
-		}
 	}
+
+	nvg__calculateSegments(ctx);
 }
 
-static int nvg__curveDivs(float r, float arc, float tol)
+static void nvg__addCurveVerts(NVGcontext* ctx, const NVGvertex* verts, int nverts)
 {
-	float da = acosf(r / (r + tol)) * 2.0f;
-	return nvg__maxi(2, (int)ceilf(arc / da));
+	NVGpath* path = nvg__lastPath(ctx);
+	if (path == NULL) return;
+
+	if (ctx->cache->ncurves+nverts > ctx->cache->ccurves) {
+		NVGvertex* curves;
+		int ccurves = ctx->cache->ncurves+nverts + ctx->cache->ccurves/2;
+		curves = (NVGvertex*)realloc(ctx->cache->curves, sizeof(NVGvertex)*ccurves);
+		if (curves == NULL) return;
+		ctx->cache->curves = curves;
+		ctx->cache->ccurves = ccurves;
+	}
+
+	memcpy(&ctx->cache->curves[ctx->cache->ncurves], verts, sizeof(NVGvertex)*nverts);
+	ctx->cache->ncurves += nverts;
+	path->ncurve += nverts;
 }
 
-static void nvg__chooseBevel(int bevel, NVGpoint* p0, NVGpoint* p1, float w,
-							float* x0, float* y0, float* x1, float* y1)
+// Adds a quadratic curve as a chord in the path and a triangle between the chord and the control point.
+// The triangle vertices carry the implicit coordinates where the curve is u*u - v = 0.
+static void nvg__addQuadratic(NVGcontext* ctx, float x0, float y0, float cx, float cy, float x1, float y1)
 {
-	if (bevel) {
-		*x0 = p1->x + p0->dy * w;
-		*y0 = p1->y - p0->dx * w;
-		*x1 = p1->x + p1->dy * w;
-		*y1 = p1->y - p1->dx * w;
-	} else {
-		*x0 = p1->x + p1->dmx * w;
-		*y0 = p1->y + p1->dmy * w;
-		*x1 = p1->x + p1->dmx * w;
-		*y1 = p1->y + p1->dmy * w;
+	NVGpoint* last = nvg__lastPoint(ctx);
+	NVGvertex verts[3];
+	float dx = x1 - x0, dy = y1 - y0;
+	float len, h;
+
+	len = nvg__normalize(&dx, &dy);
+	h = nvg__cross(dx, dy, cx - x0, cy - y0);
+
+	// Curves which are within tolerance from the chord are drawn as lines.
+	if (last == NULL || len < ctx->distTol || nvg__absf(h)*0.5f <= ctx->tessTol) {
+		nvg__addPoint(ctx, x1, y1, NVG_PT_CORNER);
+		return;
 	}
+
+	nvg__vset(&verts[0], x0, y0, 0.0f, 0.0f);
+	nvg__vset(&verts[1], cx, cy, 0.5f, 0.0f);
+	nvg__vset(&verts[2], x1, y1, 1.0f, 1.0f);
+	nvg__addCurveVerts(ctx, verts, 3);
+
+	// Curve fills have no miters, the chord start keeps the control point for the fringe joins.
+	last->flags |= NVG_PT_CHORD;
+	last->dmx = cx;
+	last->dmy = cy;
+	nvg__addPoint(ctx, x1, y1, NVG_PT_CORNER);
 }
 
-static NVGvertex* nvg__roundJoin(NVGvertex* dst, NVGpoint* p0, NVGpoint* p1,
-								 float lw, float rw, float lu, float ru, int ncap,
-								 float fringe)
+// Splits a cubic bezier into quadratic curves which are within tessellation tolerance.
+static void nvg__addCubic(NVGcontext* ctx, float x1, float y1, float x2, float y2,
+						  float x3, float y3, float x4, float y4)
 {
+	float dx = x4 - 3*x3 + 3*x2 - x1;
+	float dy = y4 - 3*y3 + 3*y2 - y1;
+	float x0 = x1, y0 = y1, tx0, ty0, dt;
 	int i, n;
-	float dlx0 = p0->dy;
-	float dly0 = -p0->dx;
-	float dlx1 = p1->dy;
-	float dly1 = -p1->dx;
-	NVG_NOTUSED(fringe);
 
-	if (p1->flags & NVG_PT_LEFT) {
-		float lx0,ly0,lx1,ly1,a0,a1;
-		nvg__chooseBevel(p1->flags & NVG_PR_INNERBEVEL, p0, p1, lw, &lx0,&ly0, &lx1,&ly1);
-		a0 = atan2f(-dly0, -dlx0);
-		a1 = atan2f(-dly1, -dlx1);
-		if (a1 > a0) a1 -= NVG_PI*2;
+	// The error of the midpoint quadratic is sqrt(3)/36 * |p3 - 3p2 + 3p1 - p0|, which scales with t^3.
+	n = (int)ceilf(nvg__cbrtf(0.0481125f * nvg__sqrtf(dx*dx + dy*dy) / ctx->tessTol));
+	n = nvg__clampi(n, 1, 64);
+	dt = 1.0f / n;
+
+	tx0 = 3*(x2 - x1);
+	ty0 = 3*(y2 - y1);
+	for (i = 1; i <= n; i++) {
+		float t = i * dt, mt = 1.0f - t;
+		float x = mt*mt*mt*x1 + 3*mt*mt*t*x2 + 3*mt*t*t*x3 + t*t*t*x4;
+		float y = mt*mt*mt*y1 + 3*mt*mt*t*y2 + 3*mt*t*t*y3 + t*t*t*y4;
+		float tx = 3*(mt*mt*(x2 - x1) + 2*mt*t*(x3 - x2) + t*t*(x4 - x3));
+		float ty = 3*(mt*mt*(y2 - y1) + 2*mt*t*(y3 - y2) + t*t*(y4 - y3));
+		// Control points of the piece, and the quadratic closest to it.
+		float cx1 = x0 + tx0*dt/3, cy1 = y0 + ty0*dt/3;
+		float cx2 = x - tx*dt/3, cy2 = y - ty*dt/3;
+		nvg__addQuadratic(ctx, x0, y0, (3*(cx1 + cx2) - x0 - x) * 0.25f, (3*(cy1 + cy2) - y0 - y) * 0.25f, x, y);
+		x0 = x; y0 = y;
+		tx0 = tx; ty0 = ty;
+	}
+}
 
-		nvg__vset(dst, lx0, ly0, lu,1); dst++;
-		nvg__vset(dst, p1->x - dlx0*rw, p1->y - dly0*rw, ru,1); dst++;
+static void nvg__reverseCurvePath(NVGcontext* ctx, NVGpath* path)
+{
+	NVGpoint* pts = &ctx->cache->points[path->first];
+	NVGvertex tmp;
+	int i, chord = pts[path->count-1].flags & NVG_PT_CHORD;
+	float cx = pts[path->count-1].dmx, cy = pts[path->count-1].dmy;
 
-		n = nvg__clampi((int)ceilf(((a0 - a1) / NVG_PI) * ncap), 2, ncap);
-		for (i = 0; i < n; i++) {
-			float u = i/(float)(n-1);
-			float a = a0 + u*(a1-a0);
-			float rx = p1->x + cosf(a) * rw;
-			float ry = p1->y + sinf(a) * rw;
-			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
-			nvg__vset(dst, rx, ry, ru,1); dst++;
-		}
+	// Chord flags and control points belong to the segment start, move them to the other end before reversing.
+	for (i = path->count-1; i > 0; i--) {
+		pts[i].flags = (unsigned char)((pts[i].flags & ~NVG_PT_CHORD) | (pts[i-1].flags & NVG_PT_CHORD));
+		pts[i].dmx = pts[i-1].dmx;
+		pts[i].dmy = pts[i-1].dmy;
+	}
+	pts[0].flags = (unsigned char)((pts[0].flags & ~NVG_PT_CHORD) | chord);
+	pts[0].dmx = cx;
+	pts[0].dmy = cy;
+	nvg__polyReverse(pts, path->count);
+
+	// Swapping the ends flips the triangles, the vertices keep their implicit coordinates.
+	for (i = 0; i < path->ncurve; i += 3) {
+		tmp = path->curve[i];
+		path->curve[i] = path->curve[i+2];
+		path->curve[i+2] = tmp;
+	}
+}
 
-		nvg__vset(dst, lx1, ly1, lu,1); dst++;
-		nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
+// Flattens the path for renderers which draw curves, see NVGpath::curve.
+// Beziers are split into quadratic curves, and only their end points are added to the path.
+static void nvg__flattenCurves(NVGcontext* ctx)
+{
+	NVGpathCache* cache = ctx->cache;
+	NVGpoint* last;
+	NVGpoint* p0;
+	NVGpoint* p1;
+	NVGpoint* pts;
+	NVGpath* path;
+	int i, j, ncurves;
+	float* cp1;
+	float* cp2;
+	float* p;
+	float area;
 
-	} else {
-		float rx0,ry0,rx1,ry1,a0,a1;
-		nvg__chooseBevel(p1->flags & NVG_PR_INNERBEVEL, p0, p1, -rw, &rx0,&ry0, &rx1,&ry1);
-		a0 = atan2f(dly0, dlx0);
-		a1 = atan2f(dly1, dlx1);
-		if (a1 < a0) a1 += NVG_PI*2;
+	nvg__clearPathCache(ctx);
 
-		nvg__vset(dst, p1->x + dlx0*rw, p1->y + dly0*rw, lu,1); dst++;
-		nvg__vset(dst, rx0, ry0, ru,1); dst++;
+	i = 0;
+	while (i < ctx->ncommands) {
+		int cmd = (int)ctx->commands[i];
+		switch (cmd) {
+		case NVG_MOVETO:
+			nvg__addPath(ctx);
+			p = &ctx->commands[i+1];
+			nvg__addPoint(ctx, p[0], p[1], NVG_PT_CORNER);
+			i += 3;
+			break;
+		case NVG_LINETO:
+			p = &ctx->commands[i+1];
+			nvg__addPoint(ctx, p[0], p[1], NVG_PT_CORNER);
+			i += 3;
+			break;
+		case NVG_BEZIERTO:
+			last = nvg__lastPoint(ctx);
+			if (last != NULL) {
+				cp1 = &ctx->commands[i+1];
+				cp2 = &ctx->commands[i+3];
+				p = &ctx->commands[i+5];
+				nvg__addCubic(ctx, last->x,last->y, cp1[0],cp1[1], cp2[0],cp2[1], p[0],p[1]);
+			}
+			i += 7;
+			break;
+		case NVG_CLOSE:
+			nvg__closePath(ctx);
+			i++;
+			break;
+		case NVG_WINDING:
+			nvg__pathWinding(ctx, (int)ctx->commands[i+1]);
+			i += 2;
+			break;
+		default:
+			i++;
+		}
+	}
 
-		n = nvg__clampi((int)ceilf(((a1 - a0) / NVG_PI) * ncap), 2, ncap);
-		for (i = 0; i < n; i++) {
-			float u = i/(float)(n-1);
-			float a = a0 + u*(a1-a0);
-			float lx = p1->x + cosf(a) * lw;
-			float ly = p1->y + sinf(a) * lw;
-			nvg__vset(dst, lx, ly, lu,1); dst++;
-			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
+	ncurves = 0;
+	for (j = 0; j < cache->npaths; j++) {
+		path = &cache->paths[j];
+		pts = &cache->points[path->first];
+		path->curve = &cache->curves[ncurves];
+		ncurves += path->ncurve;
+
+		// If the first and last points are the same, remove the last, mark as closed path.
+		if (path->count > 1) {
+			p0 = &pts[path->count-1];
+			p1 = &pts[0];
+			if (nvg__ptEquals(p0->x,p0->y, p1->x,p1->y, ctx->distTol)) {
+				path->count--;
+				path->closed = 1;
+			}
 		}
 
-		nvg__vset(dst, p1->x + dlx1*rw, p1->y + dly1*rw, lu,1); dst++;
-		nvg__vset(dst, rx1, ry1, ru,1); dst++;
+		// Enforce winding, the chords are close enough to the curves to tell it.
+		if (path->count > 2) {
+			area = nvg__polyArea(pts, path->count);
+			if ((path->winding == NVG_CCW && area < 0.0f) || (path->winding == NVG_CW && area > 0.0f))
+				nvg__reverseCurvePath(ctx, path);
+		}
+	}
 
+	nvg__calculateSegments(ctx);
+
+	// The curves stay within their triangles.
+	for (i = 0; i < cache->ncurves; i++) {
+		cache->bounds[0] = nvg__minf(cache->bounds[0], cache->curves[i].x);
+		cache->bounds[1] = nvg__minf(cache->bounds[1], cache->curves[i].y);
+		cache->bounds[2] = nvg__maxf(cache->bounds[2], cache->curves[i].x);
+		cache->bounds[3] = nvg__maxf(cache->bounds[3], cache->curves[i].y);
 	}
-	return dst;
 }
 
-static NVGvertex* nvg__bevelJoin(NVGvertex* dst, NVGpoint* p0, NVGpoint* p1,
-										float lw, float rw, float lu, float ru, float fringe)
+// Paths rebuilt from the flattened paths are appended after the original ones,
+// and moved over them when done.
+static void nvg__replacePaths(NVGcontext* ctx, int npaths, int npoints)
 {
-	float rx0,ry0,rx1,ry1;
-	float lx0,ly0,lx1,ly1;
-	float dlx0 = p0->dy;
-	float dly0 = -p0->dx;
-	float dlx1 = p1->dy;
-	float dly1 = -p1->dx;
-	NVG_NOTUSED(fringe);
-
-	if (p1->flags & NVG_PT_LEFT) {
-		nvg__chooseBevel(p1->flags & NVG_PR_INNERBEVEL, p0, p1, lw, &lx0,&ly0, &lx1,&ly1);
+	NVGpathCache* cache = ctx->cache;
+	int i;
 
-		nvg__vset(dst, lx0, ly0, lu,1); dst++;
-		nvg__vset(dst, p1->x - dlx0*rw, p1->y - dly0*rw, ru,1); dst++;
+	cache->npaths -= npaths;
+	cache->npoints -= npoints;
+	memmove(cache->paths, &cache->paths[npaths], sizeof(NVGpath)*cache->npaths);
+	memmove(cache->points, &cache->points[npoints], sizeof(NVGpoint)*cache->npoints);
+	for (i = 0; i < cache->npaths; i++)
+		cache->paths[i].first -= npoints;
 
-		if (p1->flags & NVG_PT_BEVEL) {
-			nvg__vset(dst, lx0, ly0, lu,1); dst++;
-			nvg__vset(dst, p1->x - dlx0*rw, p1->y - dly0*rw, ru,1); dst++;
+	nvg__calculateSegments(ctx);
+}
 
-			nvg__vset(dst, lx1, ly1, lu,1); dst++;
-			nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
-		} else {
-			rx0 = p1->x - p1->dmx * rw;
-			ry0 = p1->y - p1->dmy * rw;
+static NVGpoint* nvg__allocClipPoints(NVGcontext* ctx, int n)
+{
+	if (n > ctx->cache->cclip) {
+		NVGpoint* clip;
+		int cclip = n + ctx->cache->cclip/2;
+		clip = (NVGpoint*)realloc(ctx->cache->clip, sizeof(NVGpoint)*cclip);
+		if (clip == NULL) return NULL;
+		ctx->cache->clip = clip;
+		ctx->cache->cclip = cclip;
+	}
+	return ctx->cache->clip;
+}
 
-			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
-			nvg__vset(dst, p1->x - dlx0*rw, p1->y - dly0*rw, ru,1); dst++;
+static int nvg__insideEdge(float x, float y, const float* rect, int edge)
+{
+	switch (edge) {
+	case 0: return x >= rect[0];
+	case 1: return y >= rect[1];
+	case 2: return x <= rect[2];
+	default: return y <= rect[3];
+	}
+}
 
-			nvg__vset(dst, rx0, ry0, ru,1); dst++;
-			nvg__vset(dst, rx0, ry0, ru,1); dst++;
+static void nvg__clipEdge(NVGpoint* dst, const NVGpoint* p0, const NVGpoint* p1, const float* rect, int edge)
+{
+	float t;
+	if (edge == 0 || edge == 2)
+		t = (rect[edge] - p0->x) / (p1->x - p0->x);
+	else
+		t = (rect[edge] - p0->y) / (p1->y - p0->y);
+	memset(dst, 0, sizeof(*dst));
+	dst->x = p0->x + (p1->x - p0->x) * t;
+	dst->y = p0->y + (p1->y - p0->y) * t;
+	dst->flags = NVG_PT_CORNER;
+}
 
-			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
-			nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
+// Clips closed polygons against rect using Sutherland-Hodgman. The connecting
+// edges it leaves along the rect do not change the winding inside it.
+static void nvg__clipPolygon(NVGcontext* ctx, int first, int count, const float* rect)
+{
+	NVGpoint* buf;
+	NVGpoint* in;
+	NVGpoint* out;
+	NVGpath* path;
+	int i, edge, n = count, nout;
+
+	buf = nvg__allocClipPoints(ctx, n*3);
+	if (buf == NULL) return;
+	memcpy(buf, &ctx->cache->points[first], sizeof(NVGpoint)*n);
+
+	for (edge = 0; edge < 4 && n > 0; edge++) {
+		buf = nvg__allocClipPoints(ctx, n*3);
+		if (buf == NULL) return;
+		in = buf;
+		out = buf + n;
+		nout = 0;
+		for (i = 0; i < n; i++) {
+			NVGpoint* p0 = &in[i > 0 ? i-1 : n-1];
+			NVGpoint* p1 = &in[i];
+			int in0 = nvg__insideEdge(p0->x, p0->y, rect, edge);
+			int in1 = nvg__insideEdge(p1->x, p1->y, rect, edge);
+			if (in0 != in1)
+				nvg__clipEdge(&out[nout++], p0, p1, rect, edge);
+			if (in1)
+				out[nout++] = *p1;
 		}
+		memmove(buf, out, sizeof(NVGpoint)*nout);
+		n = nout;
+	}
 
-		nvg__vset(dst, lx1, ly1, lu,1); dst++;
-		nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
-
-	} else {
+	if (n < 3) return;
+	nvg__addPath(ctx);
+	for (i = 0; i < n; i++)
+		nvg__addPoint(ctx, buf[i].x, buf[i].y, buf[i].flags);
+	nvg__closePath(ctx);
+
+	// The last point may end up on the first one.
+	path = nvg__lastPath(ctx);
+	if (path != NULL && path->count > 1) {
+		NVGpoint* p0 = &ctx->cache->points[path->first];
+		NVGpoint* p1 = &ctx->cache->points[path->first + path->count-1];
+		if (nvg__ptEquals(p0->x,p0->y, p1->x,p1->y, ctx->distTol))
+			path->count--;
+	}
+}
+
+// Clips the segment p0-p1 against rect, returns the visible part as t0..t1.
+static int nvg__clipSegment(const NVGpoint* p0, const NVGpoint* p1, const float* rect, float* t0, float* t1)
+{
+	float d[4], q[4];
+	int i;
+
+	d[0] = -(p1->x - p0->x); q[0] = p0->x - rect[0];
+	d[1] = -(p1->y - p0->y); q[1] = p0->y - rect[1];
+	d[2] = p1->x - p0->x; q[2] = rect[2] - p0->x;
+	d[3] = p1->y - p0->y; q[3] = rect[3] - p0->y;
+
+	*t0 = 0.0f;
+	*t1 = 1.0f;
+	for (i = 0; i < 4; i++) {
+		if (d[i] == 0.0f) {
+			if (q[i] < 0.0f) return 0;
+		} else {
+			float t = q[i] / d[i];
+			if (d[i] < 0.0f)
+				*t0 = nvg__maxf(*t0, t);
+			else
+				*t1 = nvg__minf(*t1, t);
+		}
+	}
+	return *t0 <= *t1;
+}
+
+// Splits polylines into the runs that are inside rect.
+static void nvg__clipPolyline(NVGcontext* ctx, int first, int count, int closed, const float* rect)
+{
+	int i, start = 0, nsegs = closed ? count : count-1, open = 0;
+	float t0, t1;
+
+	// Start closed paths from an outside point so that no run wraps around.
+	if (closed) {
+		for (i = 0; i < count; i++) {
+			NVGpoint* p = &ctx->cache->points[first+i];
+			if (p->x < rect[0] || p->x > rect[2] || p->y < rect[1] || p->y > rect[3]) {
+				start = i;
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i < nsegs; i++) {
+		// Points are re-fetched since adding points may move them.
+		NVGpoint* p0 = &ctx->cache->points[first + (start+i) % count];
+		NVGpoint* p1 = &ctx->cache->points[first + (start+i+1) % count];
+		if (!nvg__clipSegment(p0, p1, rect, &t0, &t1)) {
+			open = 0;
+			continue;
+		}
+		if (!open || t0 > 0.0f) {
+			float x0 = p0->x + (p1->x - p0->x) * t0;
+			float y0 = p0->y + (p1->y - p0->y) * t0;
+			nvg__addPath(ctx);
+			nvg__addPoint(ctx, x0, y0, NVG_PT_CORNER);
+			p0 = &ctx->cache->points[first + (start+i) % count];
+			p1 = &ctx->cache->points[first + (start+i+1) % count];
+		}
+		if (t1 < 1.0f) {
+			nvg__addPoint(ctx, p0->x + (p1->x - p0->x) * t1, p0->y + (p1->y - p0->y) * t1, NVG_PT_CORNER);
+			open = 0;
+		} else {
+			nvg__addPoint(ctx, p1->x, p1->y, p1->flags);
+			open = 1;
+		}
+	}
+}
+
+// Clips the flattened paths against rect. Fills are clipped as polygons, while
+// strokes are split where they leave the rect. Returns true if the path cache was changed.
+static int nvg__clipPaths(NVGcontext* ctx, const float* rect, int polygons)
+{
+	NVGpathCache* cache = ctx->cache;
+	int i, npaths = cache->npaths, npoints = cache->npoints;
+
+	if (cache->bounds[0] >= rect[0] && cache->bounds[1] >= rect[1] &&
+		cache->bounds[2] <= rect[2] && cache->bounds[3] <= rect[3])
+		return 0;
+
+	for (i = 0; i < npaths; i++) {
+		NVGpath* path = &cache->paths[i];
+		int first = path->first, count = path->count, closed = path->closed, winding = path->winding;
+		int j, start = cache->npaths, inside = 1;
+		for (j = first; j < first+count && inside; j++) {
+			NVGpoint* p = &cache->points[j];
+			inside = p->x >= rect[0] && p->x <= rect[2] && p->y >= rect[1] && p->y <= rect[3];
+		}
+		if (inside) {
+			nvg__addPath(ctx);
+			for (j = first; j < first+count; j++)
+				nvg__addPoint(ctx, cache->points[j].x, cache->points[j].y, cache->points[j].flags);
+			if (closed)
+				nvg__closePath(ctx);
+		} else if (polygons) {
+			nvg__clipPolygon(ctx, first, count, rect);
+		} else {
+			nvg__clipPolyline(ctx, first, count, closed, rect);
+		}
+		for (j = start; j < cache->npaths; j++)
+			cache->paths[j].winding = winding;
+	}
+
+	// Drop the runs that were reduced to a single point.
+	for (i = npaths; i < cache->npaths; i++) {
+		if (cache->paths[i].count < 2) {
+			memmove(&cache->paths[i], &cache->paths[i+1], sizeof(NVGpath)*(cache->npaths-i-1));
+			cache->npaths--;
+			i--;
+		}
+	}
+
+	nvg__replacePaths(ctx, npaths, npoints);
+	return 1;
+}
+
+// A zero length dash is stretched along the path by a tiny length, so that its caps draw a dot.
+static void nvg__dashDot(NVGcontext* ctx, float dx, float dy)
+{
+	NVGpath* path = nvg__lastPath(ctx);
+	NVGpoint* pt = nvg__lastPoint(ctx);
+	float x, y;
+	if (path == NULL || pt == NULL || path->count != 1) return;
+	x = pt->x;
+	y = pt->y;
+	pt->x = x - dx*ctx->distTol;
+	pt->y = y - dy*ctx->distTol;
+	nvg__addPoint(ctx, x + dx*ctx->distTol, y + dy*ctx->distTol, NVG_PT_CORNER);
+}
+
+// Splits the flattened paths into dashes. Pattern lengths are in pixels. Zero length dashes are
+// kept as dots when the caps are not butt.
+static void nvg__dashPaths(NVGcontext* ctx, const float* pattern, int n, float offset, int lineCap)
+{
+	NVGpathCache* cache = ctx->cache;
+	int i, j, npaths = cache->npaths, npoints = cache->npoints;
+	float total = 0.0f;
+
+	for (i = 0; i < n; i++)
+		total += pattern[i];
+	offset = fmodf(offset, total);
+	if (offset < 0.0f) offset += total;
+
+	for (i = 0; i < npaths; i++) {
+		int first = cache->paths[i].first;
+		int count = cache->paths[i].count;
+		int nsegs = cache->paths[i].closed ? count : count-1;
+		int idx = 0, on;
+		float rem;
+
+		// Find the dash at the start of the path, a zero length dash right at the start is kept.
+		rem = offset;
+		while (rem > pattern[idx] || (rem > 0.0f && rem == pattern[idx])) {
+			rem -= pattern[idx];
+			idx = (idx+1) % n;
+		}
+		rem = pattern[idx] - rem;
+		on = (idx & 1) == 0;
+
+		if (on && count > 0) {
+			nvg__addPath(ctx);
+			nvg__addPoint(ctx, cache->points[first].x, cache->points[first].y, NVG_PT_CORNER);
+		}
+
+		for (j = 0; j < nsegs; j++) {
+			NVGpoint* p0 = &cache->points[first + j];
+			float len = p0->len, t = 0.0f;
+			float x0 = p0->x, y0 = p0->y, dx = p0->dx, dy = p0->dy;
+			int flags = cache->points[first + (j+1) % count].flags;
+			while (len - t > rem) {
+				t += rem;
+				if (on) {
+					nvg__addPoint(ctx, x0 + dx*t, y0 + dy*t, NVG_PT_CORNER);
+					if (lineCap != NVG_BUTT)
+						nvg__dashDot(ctx, dx, dy);
+				} else {
+					nvg__addPath(ctx);
+					nvg__addPoint(ctx, x0 + dx*t, y0 + dy*t, NVG_PT_CORNER);
+				}
+				idx = (idx+1) % n;
+				rem = pattern[idx];
+				on = !on;
+			}
+			rem -= len - t;
+			if (on)
+				nvg__addPoint(ctx, x0 + dx*len, y0 + dy*len, flags);
+		}
+	}
+
+	// Drop the zero length dashes left.
+	for (i = npaths; i < cache->npaths; i++) {
+		if (cache->paths[i].count < 2) {
+			memmove(&cache->paths[i], &cache->paths[i+1], sizeof(NVGpath)*(cache->npaths-i-1));
+			cache->npaths--;
+			i--;
+		}
+	}
+
+	nvg__replacePaths(ctx, npaths, npoints);
+}
+
+static int nvg__curveDivs(float r, float arc, float tol)
+{
+	float da = acosf(r / (r + tol)) * 2.0f;
+	return nvg__maxi(2, (int)ceilf(arc / da));
+}
+
+// Returns the number of points per half circle of round joins and caps, and the rotation between them.
+// The last result is kept, as consecutive strokes usually have the same width.
+static int nvg__roundDivs(NVGcontext* ctx, float w, float* cs, float* sn)
+{
+	if (ctx->roundDivs == 0 || ctx->roundWidth != w || ctx->roundTol != ctx->tessTol) {
+		ctx->roundDivs = nvg__curveDivs(w, NVG_PI, ctx->tessTol);
+		ctx->roundCos = nvg__cosf(NVG_PI / (ctx->roundDivs-1));
+		ctx->roundSin = nvg__sinf(NVG_PI / (ctx->roundDivs-1));
+		ctx->roundWidth = w;
+		ctx->roundTol = ctx->tessTol;
+	}
+	*cs = ctx->roundCos;
+	*sn = ctx->roundSin;
+	return ctx->roundDivs;
+}
+
+static void nvg__chooseBevel(int bevel, NVGpoint* p0, NVGpoint* p1, float w,
+							float* x0, float* y0, float* x1, float* y1)
+{
+	if (bevel) {
+		*x0 = p1->x + p0->dy * w;
+		*y0 = p1->y - p0->dx * w;
+		*x1 = p1->x + p1->dy * w;
+		*y1 = p1->y - p1->dx * w;
+	} else {
+		*x0 = p1->x + p1->dmx * w;
+		*y0 = p1->y + p1->dmy * w;
+		*x1 = p1->x + p1->dmx * w;
+		*y1 = p1->y + p1->dmy * w;
+	}
+}
+
+static NVGvertex* nvg__roundJoin(NVGvertex* dst, NVGpoint* p0, NVGpoint* p1,
+								 float lw, float rw, float lu, float ru, int ncap,
+								 float cs, float sn, float fringe)
+{
+	int i;
+	float dlx0 = p0->dy;
+	float dly0 = -p0->dx;
+	float dlx1 = p1->dy;
+	float dly1 = -p1->dx;
+	NVG_NOTUSED(fringe);
+
+	// The arc is rotated one division at a time from the start direction, until the end direction
+	// is less than a division away. The points are at most one division apart, as before.
+	if (p1->flags & NVG_PT_LEFT) {
+		float lx0,ly0,lx1,ly1,ax,ay,t;
+		nvg__chooseBevel(p1->flags & NVG_PR_INNERBEVEL, p0, p1, lw, &lx0,&ly0, &lx1,&ly1);
+
+		nvg__vset(dst, lx0, ly0, lu,1); dst++;
+		nvg__vset(dst, p1->x - dlx0*rw, p1->y - dly0*rw, ru,1); dst++;
+
+		// Clockwise from -dl0 to -dl1.
+		ax = -dlx0; ay = -dly0;
+		for (i = 0; i < ncap-1; i++) {
+			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
+			nvg__vset(dst, p1->x + ax*rw, p1->y + ay*rw, ru,1); dst++;
+			t = ax*cs + ay*sn;
+			ay = ay*cs - ax*sn;
+			ax = t;
+			if (ax*dlx1 + ay*dly1 < 0.0f && ax*dly1 - ay*dlx1 < 0.001f) break;
+		}
+		nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
+		nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
+
+		nvg__vset(dst, lx1, ly1, lu,1); dst++;
+		nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
+
+	} else {
+		float rx0,ry0,rx1,ry1,ax,ay,t;
+		nvg__chooseBevel(p1->flags & NVG_PR_INNERBEVEL, p0, p1, -rw, &rx0,&ry0, &rx1,&ry1);
+
+		nvg__vset(dst, p1->x + dlx0*rw, p1->y + dly0*rw, lu,1); dst++;
+		nvg__vset(dst, rx0, ry0, ru,1); dst++;
+
+		// Counter-clockwise from dl0 to dl1.
+		ax = dlx0; ay = dly0;
+		for (i = 0; i < ncap-1; i++) {
+			nvg__vset(dst, p1->x + ax*lw, p1->y + ay*lw, lu,1); dst++;
+			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
+			t = ax*cs - ay*sn;
+			ay = ay*cs + ax*sn;
+			ax = t;
+			if (ax*dlx1 + ay*dly1 > 0.0f && ax*dly1 - ay*dlx1 < 0.001f) break;
+		}
+		nvg__vset(dst, p1->x + dlx1*lw, p1->y + dly1*lw, lu,1); dst++;
+		nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
+
+		nvg__vset(dst, p1->x + dlx1*rw, p1->y + dly1*rw, lu,1); dst++;
+		nvg__vset(dst, rx1, ry1, ru,1); dst++;
+
+	}
+	return dst;
+}
+
+static NVGvertex* nvg__bevelJoin(NVGvertex* dst, NVGpoint* p0, NVGpoint* p1,
+										float lw, float rw, float lu, float ru, float fringe)
+{
+	float rx0,ry0,rx1,ry1;
+	float lx0,ly0,lx1,ly1;
+	float dlx0 = p0->dy;
+	float dly0 = -p0->dx;
+	float dlx1 = p1->dy;
+	float dly1 = -p1->dx;
+	NVG_NOTUSED(fringe);
+
+	if (p1->flags & NVG_PT_LEFT) {
+		nvg__chooseBevel(p1->flags & NVG_PR_INNERBEVEL, p0, p1, lw, &lx0,&ly0, &lx1,&ly1);
+
+		nvg__vset(dst, lx0, ly0, lu,1); dst++;
+		nvg__vset(dst, p1->x - dlx0*rw, p1->y - dly0*rw, ru,1); dst++;
+
+		if (p1->flags & NVG_PT_BEVEL) {
+			nvg__vset(dst, lx0, ly0, lu,1); dst++;
+			nvg__vset(dst, p1->x - dlx0*rw, p1->y - dly0*rw, ru,1); dst++;
+
+			nvg__vset(dst, lx1, ly1, lu,1); dst++;
+			nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
+		} else {
+			rx0 = p1->x - p1->dmx * rw;
+			ry0 = p1->y - p1->dmy * rw;
+
+			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
+			nvg__vset(dst, p1->x - dlx0*rw, p1->y - dly0*rw, ru,1); dst++;
+
+			nvg__vset(dst, rx0, ry0, ru,1); dst++;
+			nvg__vset(dst, rx0, ry0, ru,1); dst++;
+
+			nvg__vset(dst, p1->x, p1->y, 0.5f,1); dst++;
+			nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
+		}
+
+		nvg__vset(dst, lx1, ly1, lu,1); dst++;
+		nvg__vset(dst, p1->x - dlx1*rw, p1->y - dly1*rw, ru,1); dst++;
+
+	} else {
 		nvg__chooseBevel(p1->flags & NVG_PR_INNERBEVEL, p0, p1, -rw, &rx0,&ry0, &rx1,&ry1);
 
 		nvg__vset(dst, p1->x + dlx0*lw, p1->y + dly0*lw, lu,1); dst++;
@@ -1605,20 +2363,23 @@ static NVGvertex* nvg__buttCapEnd(NVGvertex* dst, NVGpoint* p,
 
 
 static NVGvertex* nvg__roundCapStart(NVGvertex* dst, NVGpoint* p,
-									 float dx, float dy, float w, int ncap,
+									 float dx, float dy, float w, int ncap, float cs, float sn,
 									 float aa, float u0, float u1)
 {
 	int i;
+	float ax = w, ay = 0.0f, t;
 	float px = p->x;
 	float py = p->y;
 	float dlx = dy;
 	float dly = -dx;
 	NVG_NOTUSED(aa);
 	for (i = 0; i < ncap; i++) {
-		float a = i/(float)(ncap-1)*NVG_PI;
-		float ax = cosf(a) * w, ay = sinf(a) * w;
 		nvg__vset(dst, px - dlx*ax - dx*ay, py - dly*ax - dy*ay, u0,1); dst++;
 		nvg__vset(dst, px, py, 0.5f,1); dst++;
+		// Rotate by one division.
+		t = ax*cs - ay*sn;
+		ay = ay*cs + ax*sn;
+		ax = t;
 	}
 	nvg__vset(dst, px + dlx*w, py + dly*w, u0,1); dst++;
 	nvg__vset(dst, px - dlx*w, py - dly*w, u1,1); dst++;
@@ -1626,10 +2387,11 @@ static NVGvertex* nvg__roundCapStart(NVGvertex* dst, NVGpoint* p,
 }
 
 static NVGvertex* nvg__roundCapEnd(NVGvertex* dst, NVGpoint* p,
-								   float dx, float dy, float w, int ncap,
+								   float dx, float dy, float w, int ncap, float cs, float sn,
 								   float aa, float u0, float u1)
 {
 	int i;
+	float ax = w, ay = 0.0f, t;
 	float px = p->x;
 	float py = p->y;
 	float dlx = dy;
@@ -1638,10 +2400,12 @@ static NVGvertex* nvg__roundCapEnd(NVGvertex* dst, NVGpoint* p,
 	nvg__vset(dst, px + dlx*w, py + dly*w, u0,1); dst++;
 	nvg__vset(dst, px - dlx*w, py - dly*w, u1,1); dst++;
 	for (i = 0; i < ncap; i++) {
-		float a = i/(float)(ncap-1)*NVG_PI;
-		float ax = cosf(a) * w, ay = sinf(a) * w;
 		nvg__vset(dst, px, py, 0.5f,1); dst++;
 		nvg__vset(dst, px - dlx*ax + dx*ay, py - dly*ax + dy*ay, u0,1); dst++;
+		// Rotate by one division.
+		t = ax*cs - ay*sn;
+		ay = ay*cs + ax*sn;
+		ax = t;
 	}
 	return dst;
 }
@@ -1652,80 +2416,123 @@ static void nvg__calculateJoins(NVGcontext* ctx, float w, int lineJoin, float mi
 	NVGpathCache* cache = ctx->cache;
 	int i, j;
 	float iw = 0.0f;
+	int alwaysBevel = lineJoin == NVG_BEVEL || lineJoin == NVG_ROUND;
 
 	if (w > 0.0f) iw = 1.0f / w;
 
 	// Calculate which joins needs extra vertices to append, and gather vertex count.
+	// The flags and counts are computed with selects instead of branches, as they are hard to predict.
 	for (i = 0; i < cache->npaths; i++) {
 		NVGpath* path = &cache->paths[i];
 		NVGpoint* pts = &cache->points[path->first];
 		NVGpoint* p0 = &pts[path->count-1];
 		NVGpoint* p1 = &pts[0];
-		int nleft = 0;
-
-		path->nbevel = 0;
+		int nleft = 0, nflips = 0, nbevel = 0;
+		float lastdx = 0.0f;
 
 		for (j = 0; j < path->count; j++) {
-			float dlx0, dly0, dlx1, dly1, dmr2, cross, limit;
-			dlx0 = p0->dy;
-			dly0 = -p0->dx;
-			dlx1 = p1->dy;
-			dly1 = -p1->dx;
+			float dmr2, scale, cross, limit;
+			int flags, moving;
 			// Calculate extrusions
-			p1->dmx = (dlx0 + dlx1) * 0.5f;
-			p1->dmy = (dly0 + dly1) * 0.5f;
+			p1->dmx = (p0->dy + p1->dy) * 0.5f;
+			p1->dmy = -(p0->dx + p1->dx) * 0.5f;
 			dmr2 = p1->dmx*p1->dmx + p1->dmy*p1->dmy;
-			if (dmr2 > 0.000001f) {
-				float scale = 1.0f / dmr2;
-				if (scale > 600.0f) {
-					scale = 600.0f;
-				}
-				p1->dmx *= scale;
-				p1->dmy *= scale;
-			}
-
-			// Clear flags, but keep the corner.
-			p1->flags = (p1->flags & NVG_PT_CORNER) ? NVG_PT_CORNER : 0;
+			scale = dmr2 > 0.000001f ? nvg__minf(1.0f / dmr2, 600.0f) : 1.0f;
+			p1->dmx *= scale;
+			p1->dmy *= scale;
 
-			// Keep track of left turns.
+			// Keep track of left turns, clear the other flags but keep the corner.
 			cross = p1->dx * p0->dy - p0->dx * p1->dy;
-			if (cross > 0.0f) {
-				nleft++;
-				p1->flags |= NVG_PT_LEFT;
-			}
+			flags = (p1->flags & NVG_PT_CORNER) | (cross > 0.0f ? NVG_PT_LEFT : 0);
+			nleft += cross > 0.0f;
+
+			// Count the reversals of x direction, a shape that loops more than once has over two.
+			moving = nvg__absf(p1->dx) > 0.001f;
+			nflips += moving & (lastdx * p1->dx < 0.0f);
+			lastdx = moving ? p1->dx : lastdx;
 
 			// Calculate if we should use bevel or miter for inner join.
 			limit = nvg__maxf(1.01f, nvg__minf(p0->len, p1->len) * iw);
-			if ((dmr2 * limit*limit) < 1.0f)
-				p1->flags |= NVG_PR_INNERBEVEL;
+			flags |= (dmr2 * limit*limit) < 1.0f ? NVG_PR_INNERBEVEL : 0;
 
 			// Check to see if the corner needs to be beveled.
-			if (p1->flags & NVG_PT_CORNER) {
-				if ((dmr2 * miterLimit*miterLimit) < 1.0f || lineJoin == NVG_BEVEL || lineJoin == NVG_ROUND) {
-					p1->flags |= NVG_PT_BEVEL;
-				}
-			}
+			flags |= ((flags & NVG_PT_CORNER) != 0) & (alwaysBevel | ((dmr2 * miterLimit*miterLimit) < 1.0f)) ? NVG_PT_BEVEL : 0;
 
-			if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0)
-				path->nbevel++;
+			nbevel += (flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0;
+			p1->flags = (unsigned char)flags;
 
 			p0 = p1++;
 		}
 
-		path->convex = (nleft == path->count) ? 1 : 0;
+		path->nbevel = nbevel;
+		path->convex = (nleft == path->count && nflips <= 2) ? 1 : 0;
 	}
 }
 
 
+// Stroke kernels, with one join loop per join type so that the inner loops do not branch on it.
+// The points flagged for a bevel get a bevel or round join, the others are mitered.
+static NVGvertex* nvg__bevelJoins(NVGvertex* dst, NVGpoint* p0, NVGpoint* p1, int n,
+								  float w, float u0, float u1, float aa)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0) {
+			dst = nvg__bevelJoin(dst, p0, p1, w, w, u0, u1, aa);
+		} else {
+			nvg__vset(dst, p1->x + (p1->dmx * w), p1->y + (p1->dmy * w), u0,1); dst++;
+			nvg__vset(dst, p1->x - (p1->dmx * w), p1->y - (p1->dmy * w), u1,1); dst++;
+		}
+		p0 = p1++;
+	}
+	return dst;
+}
+
+static NVGvertex* nvg__roundJoins(NVGvertex* dst, NVGpoint* p0, NVGpoint* p1, int n,
+								  float w, float u0, float u1, int ncap, float cs, float sn, float aa)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0) {
+			dst = nvg__roundJoin(dst, p0, p1, w, w, u0, u1, ncap, cs, sn, aa);
+		} else {
+			nvg__vset(dst, p1->x + (p1->dmx * w), p1->y + (p1->dmy * w), u0,1); dst++;
+			nvg__vset(dst, p1->x - (p1->dmx * w), p1->y - (p1->dmy * w), u1,1); dst++;
+		}
+		p0 = p1++;
+	}
+	return dst;
+}
+
+// Adds the cap at p0 of the segment p0-p1 when start is set, and the cap at p1 otherwise.
+static NVGvertex* nvg__cap(NVGvertex* dst, NVGpoint* p0, NVGpoint* p1, int start, int lineCap,
+						   float w, int ncap, float cs, float sn, float aa, float u0, float u1)
+{
+	float dx = p1->x - p0->x;
+	float dy = p1->y - p0->y;
+	nvg__normalize(&dx, &dy);
+	if (lineCap == NVG_BUTT) {
+		if (start) return nvg__buttCapStart(dst, p0, dx, dy, w, -aa*0.5f, aa, u0, u1);
+		return nvg__buttCapEnd(dst, p1, dx, dy, w, -aa*0.5f, aa, u0, u1);
+	} else if (lineCap == NVG_SQUARE) {
+		if (start) return nvg__buttCapStart(dst, p0, dx, dy, w, w-aa, aa, u0, u1);
+		return nvg__buttCapEnd(dst, p1, dx, dy, w, w-aa, aa, u0, u1);
+	} else if (lineCap == NVG_ROUND) {
+		if (start) return nvg__roundCapStart(dst, p0, dx, dy, w, ncap, cs, sn, aa, u0, u1);
+		return nvg__roundCapEnd(dst, p1, dx, dy, w, ncap, cs, sn, aa, u0, u1);
+	}
+	return dst;
+}
+
 static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap, int lineJoin, float miterLimit)
 {
 	NVGpathCache* cache = ctx->cache;
 	NVGvertex* verts;
 	NVGvertex* dst;
-	int cverts, i, j;
+	int cverts, i;
 	float aa = fringe;//ctx->fringeWidth;
-	float u0 = 0.0f, u1 = 1.0f;
-	int ncap = nvg__curveDivs(w, NVG_PI, ctx->tessTol);	// Calculate divisions per half circle.
+	float u0 = 0.0f, u1 = 1.0f, cs, sn;
+	int ncap = nvg__roundDivs(ctx, w, &cs, &sn);	// Calculate divisions per half circle.
 
 	w += aa * 0.5f;
 
@@ -1765,7 +2572,6 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 		NVGpoint* p0;
 		NVGpoint* p1;
 		int s, e, loop;
-		float dx, dy;
 
 		path->fill = 0;
 		path->nfill = 0;
@@ -1787,50 +2593,22 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 			p1 = &pts[1];
 			s = 1;
 			e = path->count-1;
+			dst = nvg__cap(dst, p0, p1, 1, lineCap, w, ncap, cs, sn, aa, u0, u1);
 		}
 
-		if (loop == 0) {
-			// Add cap
-			dx = p1->x - p0->x;
-			dy = p1->y - p0->y;
-			nvg__normalize(&dx, &dy);
-			if (lineCap == NVG_BUTT)
-				dst = nvg__buttCapStart(dst, p0, dx, dy, w, -aa*0.5f, aa, u0, u1);
-			else if (lineCap == NVG_BUTT || lineCap == NVG_SQUARE)
-				dst = nvg__buttCapStart(dst, p0, dx, dy, w, w-aa, aa, u0, u1);
-			else if (lineCap == NVG_ROUND)
-				dst = nvg__roundCapStart(dst, p0, dx, dy, w, ncap, aa, u0, u1);
-		}
-
-		for (j = s; j < e; ++j) {
-			if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0) {
-				if (lineJoin == NVG_ROUND) {
-					dst = nvg__roundJoin(dst, p0, p1, w, w, u0, u1, ncap, aa);
-				} else {
-					dst = nvg__bevelJoin(dst, p0, p1, w, w, u0, u1, aa);
-				}
-			} else {
-				nvg__vset(dst, p1->x + (p1->dmx * w), p1->y + (p1->dmy * w), u0,1); dst++;
-				nvg__vset(dst, p1->x - (p1->dmx * w), p1->y - (p1->dmy * w), u1,1); dst++;
-			}
-			p0 = p1++;
-		}
+		if (lineJoin == NVG_ROUND)
+			dst = nvg__roundJoins(dst, p0, p1, e - s, w, u0, u1, ncap, cs, sn, aa);
+		else
+			dst = nvg__bevelJoins(dst, p0, p1, e - s, w, u0, u1, aa);
 
 		if (loop) {
 			// Loop it
 			nvg__vset(dst, verts[0].x, verts[0].y, u0,1); dst++;
 			nvg__vset(dst, verts[1].x, verts[1].y, u1,1); dst++;
 		} else {
-			// Add cap
-			dx = p1->x - p0->x;
-			dy = p1->y - p0->y;
-			nvg__normalize(&dx, &dy);
-			if (lineCap == NVG_BUTT)
-				dst = nvg__buttCapEnd(dst, p1, dx, dy, w, -aa*0.5f, aa, u0, u1);
-			else if (lineCap == NVG_BUTT || lineCap == NVG_SQUARE)
-				dst = nvg__buttCapEnd(dst, p1, dx, dy, w, w-aa, aa, u0, u1);
-			else if (lineCap == NVG_ROUND)
-				dst = nvg__roundCapEnd(dst, p1, dx, dy, w, ncap, aa, u0, u1);
+			// Add cap, p1 is advanced past the joins.
+			p1 += nvg__maxi(e - s, 0);
+			dst = nvg__cap(dst, p1-1, p1, 0, lineCap, w, ncap, cs, sn, aa, u0, u1);
 		}
 
 		path->nstroke = (int)(dst - verts);
@@ -1841,6 +2619,268 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 	return 1;
 }
 
+// Expands strokes thinner than a pixel as one strip with a quad per segment, without join or cap geometry.
+// The quads share their ends along the bisector, sharp turns start a new quad from the same point instead.
+static int nvg__expandHairline(NVGcontext* ctx, float w, int lineCap)
+{
+	NVGpathCache* cache = ctx->cache;
+	NVGvertex* verts;
+	NVGvertex* dst;
+	// Butt ends stop at the end points, the other caps reach half a pixel further.
+	float ext = lineCap == NVG_BUTT ? 0.0f : w*0.5f;
+	int cverts = 0, i, j;
+
+	for (i = 0; i < cache->npaths; i++)
+		cverts += cache->paths[i].count*4 + 2;
+
+	verts = nvg__allocTempVerts(ctx, cverts);
+	if (verts == NULL) return 0;
+
+	for (i = 0; i < cache->npaths; i++) {
+		NVGpath* path = &cache->paths[i];
+		NVGpoint* pts = &cache->points[path->first];
+		NVGpoint* p0 = &pts[path->count-1];
+		NVGpoint* p1 = &pts[0];
+
+		path->fill = 0;
+		path->nfill = 0;
+		path->stroke = verts;
+		dst = verts;
+
+		for (j = 0; j < path->count && path->count > 1; j++) {
+			float dmx, dmy, dmr2;
+			if (!path->closed && j == 0) {
+				nvg__vset(dst, p1->x + p1->dy*w - p1->dx*ext, p1->y - p1->dx*w - p1->dy*ext, 0.0f,1); dst++;
+				nvg__vset(dst, p1->x - p1->dy*w - p1->dx*ext, p1->y + p1->dx*w - p1->dy*ext, 1.0f,1); dst++;
+			} else if (!path->closed && j == path->count-1) {
+				nvg__vset(dst, p1->x + p0->dy*w + p0->dx*ext, p1->y - p0->dx*w + p0->dy*ext, 0.0f,1); dst++;
+				nvg__vset(dst, p1->x - p0->dy*w + p0->dx*ext, p1->y + p0->dx*w + p0->dy*ext, 1.0f,1); dst++;
+			} else {
+				dmx = (p0->dy + p1->dy) * 0.5f;
+				dmy = -(p0->dx + p1->dx) * 0.5f;
+				dmr2 = dmx*dmx + dmy*dmy;
+				if (dmr2 >= 0.25f) {
+					// The miter is at most twice the width here.
+					dmx *= w / dmr2;
+					dmy *= w / dmr2;
+					nvg__vset(dst, p1->x + dmx, p1->y + dmy, 0.0f,1); dst++;
+					nvg__vset(dst, p1->x - dmx, p1->y - dmy, 1.0f,1); dst++;
+				} else {
+					nvg__vset(dst, p1->x + p0->dy*w, p1->y - p0->dx*w, 0.0f,1); dst++;
+					nvg__vset(dst, p1->x - p0->dy*w, p1->y + p0->dx*w, 1.0f,1); dst++;
+					nvg__vset(dst, p1->x + p1->dy*w, p1->y - p1->dx*w, 0.0f,1); dst++;
+					nvg__vset(dst, p1->x - p1->dy*w, p1->y + p1->dx*w, 1.0f,1); dst++;
+				}
+			}
+			p0 = p1++;
+		}
+
+		if (path->closed && dst > verts) {
+			// Loop it
+			nvg__vset(dst, verts[0].x, verts[0].y, 0.0f,1); dst++;
+			nvg__vset(dst, verts[1].x, verts[1].y, 1.0f,1); dst++;
+		}
+
+		path->nstroke = (int)(dst - verts);
+		verts = dst;
+	}
+
+	return 1;
+}
+
+// Stores the flattened points of each path as stroke vertices, for renderers that expand strokes themselves.
+static int nvg__strokePoints(NVGcontext* ctx)
+{
+	NVGpathCache* cache = ctx->cache;
+	NVGvertex* verts;
+	int i, j;
+
+	verts = nvg__allocTempVerts(ctx, cache->npoints);
+	if (verts == NULL) return 0;
+
+	for (i = 0; i < cache->npaths; i++) {
+		NVGpath* path = &cache->paths[i];
+		NVGpoint* pts = &cache->points[path->first];
+		path->fill = 0;
+		path->nfill = 0;
+		path->stroke = verts;
+		for (j = 0; j < path->count; j++)
+			nvg__vset(verts++, pts[j].x, pts[j].y, 0.5f, 1.0f);
+		path->nstroke = (int)(verts - path->stroke);
+	}
+
+	return 1;
+}
+
+static NVGpath** nvg__allocPathOrder(NVGcontext* ctx, int n)
+{
+	if (n > ctx->cache->corder) {
+		NVGpath** order;
+		int corder = n + ctx->cache->corder/2;
+		order = (NVGpath**)realloc(ctx->cache->order, sizeof(NVGpath*)*corder);
+		if (order == NULL) return NULL;
+		ctx->cache->order = order;
+		ctx->cache->corder = corder;
+	}
+	return ctx->cache->order;
+}
+
+static int nvg__cmpPathLeft(const void* a, const void* b)
+{
+	float ax = (*(NVGpath* const*)a)->bounds[0];
+	float bx = (*(NVGpath* const*)b)->bounds[0];
+	return ax < bx ? -1 : (ax > bx ? 1 : 0);
+}
+
+// Marks the paths that can be filled without stencil. A path that does not overlap the others covers
+// its inside once if it is convex, as convex paths all turn the same way, or if it can be triangulated.
+static void nvg__classifyFillPaths(NVGcontext* ctx, float margin)
+{
+	NVGpathCache* cache = ctx->cache;
+	NVGpath** order;
+	int i, j, n = cache->npaths;
+	for (i = 0; i < n; i++) {
+		NVGpath* path = &cache->paths[i];
+		path->triangulated = 0;
+		// The fill without stencil is back-face culled, leave holes to the stencil fill.
+		if (n > 1 && path->winding != NVG_CCW)
+			path->convex = 0;
+		// Cleared later if the fill polygon is not simple.
+		if (!path->convex && ctx->params.triangulateFills && path->winding == NVG_CCW &&
+			path->count > 3 && path->count <= NVG_MAX_TRIANGULATE)
+			path->triangulated = 1;
+	}
+	if (n < 2)
+		return;
+
+	order = nvg__allocPathOrder(ctx, n);
+	if (order == NULL) {
+		for (i = 0; i < n; i++)
+			cache->paths[i].convex = cache->paths[i].triangulated = 0;
+		return;
+	}
+	for (i = 0; i < n; i++)
+		order[i] = &cache->paths[i];
+	qsort(order, n, sizeof(NVGpath*), nvg__cmpPathLeft);
+
+	// Sweep the paths from left to right, only the paths starting before the right edge of a path,
+	// grown by margin, can touch it.
+	for (i = 0; i < n; i++) {
+		NVGpath* a = order[i];
+		for (j = i+1; j < n && order[j]->bounds[0] <= a->bounds[2] + margin; j++) {
+			NVGpath* b = order[j];
+			if (!nvg__outsideRect(a->bounds, b->bounds, margin)) {
+				a->convex = a->triangulated = 0;
+				b->convex = b->triangulated = 0;
+			}
+		}
+	}
+}
+
+static int* nvg__allocIndices(NVGcontext* ctx, int n)
+{
+	if (n > ctx->cache->cindices) {
+		int* indices;
+		int cindices = n + ctx->cache->cindices/2;
+		indices = (int*)realloc(ctx->cache->indices, sizeof(int)*cindices);
+		if (indices == NULL) return NULL;
+		ctx->cache->indices = indices;
+		ctx->cache->cindices = cindices;
+	}
+	return ctx->cache->indices;
+}
+
+static int nvg__segmentsCross(const NVGvertex* a, const NVGvertex* b, const NVGvertex* c, const NVGvertex* d)
+{
+	if (nvg__maxf(a->x, b->x) < nvg__minf(c->x, d->x) || nvg__minf(a->x, b->x) > nvg__maxf(c->x, d->x) ||
+		nvg__maxf(a->y, b->y) < nvg__minf(c->y, d->y) || nvg__minf(a->y, b->y) > nvg__maxf(c->y, d->y))
+		return 0;
+	return nvg__triarea2(a->x,a->y, b->x,b->y, c->x,c->y) * nvg__triarea2(a->x,a->y, b->x,b->y, d->x,d->y) <= 0.0f &&
+		   nvg__triarea2(c->x,c->y, d->x,d->y, a->x,a->y) * nvg__triarea2(c->x,c->y, d->x,d->y, b->x,b->y) <= 0.0f;
+}
+
+static int nvg__simplePolygon(const NVGvertex* poly, int n)
+{
+	int i, j;
+	for (i = 0; i < n-2; i++) {
+		for (j = i+2; j < n; j++) {
+			if (i == 0 && j == n-1) continue;
+			if (nvg__segmentsCross(&poly[i], &poly[i+1], &poly[j], &poly[(j+1) % n]))
+				return 0;
+		}
+	}
+	return 1;
+}
+
+// Returns 1 if no other remaining vertex is inside or on the corner triangle a,b,c turning in direction dir.
+static int nvg__isEar(const NVGvertex* poly, const int* next, int a, int b, int c, float dir)
+{
+	const NVGvertex* pa = &poly[a];
+	const NVGvertex* pb = &poly[b];
+	const NVGvertex* pc = &poly[c];
+	int i;
+	if (nvg__triarea2(pa->x,pa->y, pb->x,pb->y, pc->x,pc->y) * dir <= 0.0f)
+		return 0;
+	for (i = next[c]; i != a; i = next[i]) {
+		const NVGvertex* p = &poly[i];
+		if (nvg__ptEquals(p->x,p->y, pa->x,pa->y, 1e-6f) || nvg__ptEquals(p->x,p->y, pc->x,pc->y, 1e-6f))
+			continue;
+		if (nvg__triarea2(pa->x,pa->y, pb->x,pb->y, p->x,p->y) * dir >= 0.0f &&
+			nvg__triarea2(pb->x,pb->y, pc->x,pc->y, p->x,p->y) * dir >= 0.0f &&
+			nvg__triarea2(pc->x,pc->y, pa->x,pa->y, p->x,p->y) * dir >= 0.0f)
+			return 0;
+	}
+	return 1;
+}
+
+// Triangulates a simple polygon by ear clipping. Returns the number of triangle list
+// vertices written to dst, or 0 if the polygon is self-intersecting or clipping gets stuck.
+static int nvg__triangulate(NVGcontext* ctx, const NVGvertex* poly, int n, NVGvertex* dst)
+{
+	int* next;
+	int* prev;
+	int i, a, c, remaining, stall, nverts = 0;
+	float area = 0.0f, dir;
+
+	if (n < 3 || !nvg__simplePolygon(poly, n)) return 0;
+	next = nvg__allocIndices(ctx, n*2);
+	if (next == NULL) return 0;
+	prev = next + n;
+
+	for (i = 0; i < n; i++) {
+		next[i] = (i+1) % n;
+		prev[i] = (i+n-1) % n;
+		if (i >= 2)
+			area += nvg__triarea2(poly[0].x,poly[0].y, poly[i-1].x,poly[i-1].y, poly[i].x,poly[i].y);
+	}
+	if (area == 0.0f) return 0;
+	dir = area > 0.0f ? 1.0f : -1.0f;
+
+	i = 0;
+	stall = 0;
+	for (remaining = n; remaining > 3; ) {
+		a = prev[i];
+		c = next[i];
+		if (nvg__isEar(poly, next, a, i, c, dir)) {
+			dst[nverts++] = poly[a];
+			dst[nverts++] = poly[i];
+			dst[nverts++] = poly[c];
+			next[a] = c;
+			prev[c] = a;
+			remaining--;
+			stall = 0;
+		} else if (++stall > remaining) {
+			return 0;
+		}
+		i = c;
+	}
+	dst[nverts++] = poly[prev[i]];
+	dst[nverts++] = poly[i];
+	dst[nverts++] = poly[next[i]];
+
+	return nverts;
+}
+
 static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLimit)
 {
 	NVGpathCache* cache = ctx->cache;
@@ -1851,12 +2891,15 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 	int fringe = w > 0.0f;
 
 	nvg__calculateJoins(ctx, w, lineJoin, miterLimit);
+	nvg__classifyFillPaths(ctx, aa);
 
 	// Calculate max vertex usage.
 	cverts = 0;
 	for (i = 0; i < cache->npaths; i++) {
 		NVGpath* path = &cache->paths[i];
 		cverts += path->count + path->nbevel + 1;
+		if (path->triangulated)
+			cverts += (path->count + path->nbevel) * 3;
 		if (fringe)
 			cverts += (path->count + path->nbevel*5 + 1) * 2; // plus one for loop
 	}
@@ -1864,8 +2907,6 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 	verts = nvg__allocTempVerts(ctx, cverts);
 	if (verts == NULL) return 0;
 
-	convex = cache->npaths == 1 && cache->paths[0].convex;
-
 	for (i = 0; i < cache->npaths; i++) {
 		NVGpath* path = &cache->paths[i];
 		NVGpoint* pts = &cache->points[path->first];
@@ -1916,40 +2957,188 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 		path->nfill = (int)(dst - verts);
 		verts = dst;
 
-		// Calculate fringe
-		if (fringe) {
-			lw = w + woff;
-			rw = w - woff;
-			lu = 0;
-			ru = 1;
+		if (path->triangulated) {
+			int n = nvg__triangulate(ctx, path->fill, path->nfill, verts);
+			if (n > 0) {
+				path->fill = verts;
+				path->nfill = n;
+				verts += n;
+			} else {
+				path->triangulated = 0;
+			}
+		}
+		convex = path->convex || path->triangulated;
+
+		// Calculate fringe
+		if (fringe) {
+			lw = w + woff;
+			rw = w - woff;
+			lu = 0;
+			ru = 1;
+			dst = verts;
+			path->stroke = dst;
+
+			// Create only half a fringe for convex shapes so that
+			// the shape can be rendered without stenciling.
+			if (convex) {
+				lw = woff;	// This should generate the same vertex as fill inset above.
+				lu = 0.5f;	// Set outline fade at middle.
+			}
+
+			// Looping
+			p0 = &pts[path->count-1];
+			p1 = &pts[0];
+
+			for (j = 0; j < path->count; ++j) {
+				if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0) {
+					dst = nvg__bevelJoin(dst, p0, p1, lw, rw, lu, ru, ctx->fringeWidth);
+				} else {
+					nvg__vset(dst, p1->x + (p1->dmx * lw), p1->y + (p1->dmy * lw), lu,1); dst++;
+					nvg__vset(dst, p1->x - (p1->dmx * rw), p1->y - (p1->dmy * rw), ru,1); dst++;
+				}
+				p0 = p1++;
+			}
+
+			// Loop it
+			nvg__vset(dst, verts[0].x, verts[0].y, lu,1); dst++;
+			nvg__vset(dst, verts[1].x, verts[1].y, ru,1); dst++;
+
+			path->nstroke = (int)(dst - verts);
+			verts = dst;
+		} else {
+			path->stroke = NULL;
+			path->nstroke = 0;
+		}
+	}
+
+	return 1;
+}
+
+// Adds a quad around a curve triangle, expanded by the fringe width.
+// The implicit coordinates are extrapolated so that the fringe can be evaluated outside the triangle.
+static NVGvertex* nvg__curveFringe(NVGvertex* dst, const NVGvertex* tri, float aa)
+{
+	NVGvertex quad[4];
+	float ex = tri[2].x - tri[0].x, ey = tri[2].y - tri[0].y;
+	float len, ac, h, a, b, s, t;
+	int i;
+
+	len = nvg__normalize(&ex, &ey);
+	ac = (tri[1].x - tri[0].x)*ex + (tri[1].y - tri[0].y)*ey;
+	h = (tri[1].y - tri[0].y)*ex - (tri[1].x - tri[0].x)*ey;
+
+	for (i = 0; i < 4; i++) {
+		a = (i & 1) ? nvg__maxf(len, ac) + aa : nvg__minf(0.0f, ac) - aa;
+		b = (i & 2) ? nvg__maxf(0.0f, h) + aa : nvg__minf(0.0f, h) - aa;
+		s = b / h;
+		t = (a - s*ac) / len;
+		nvg__vset(&quad[i], tri[0].x + ex*a - ey*b, tri[0].y + ey*a + ex*b,
+				  tri[0].u + (tri[1].u - tri[0].u)*s + (tri[2].u - tri[0].u)*t,
+				  tri[0].v + (tri[1].v - tri[0].v)*s + (tri[2].v - tri[0].v)*t);
+	}
+
+	*dst++ = quad[0]; *dst++ = quad[1]; *dst++ = quad[2];
+	*dst++ = quad[2]; *dst++ = quad[1]; *dst++ = quad[3];
+	return dst;
+}
+
+// Builds the vertices for paths flattened by nvg__flattenCurves().
+// The fringes are quads around the curve triangles and the straight segments,
+// for the straight segments |v| is the distance to the segment in fringe widths.
+// Direction of the segment or curve from p0 at its start, or at its end.
+static int nvg__curveFillDir(const NVGpoint* p0, const NVGpoint* p1, int end, float* dx, float* dy)
+{
+	if (p0->flags & NVG_PT_CHORD) {
+		*dx = end ? p1->x - p0->dmx : p0->dmx - p0->x;
+		*dy = end ? p1->y - p0->dmy : p0->dmy - p0->y;
+		return nvg__normalize(dx, dy) > 0.0f;
+	}
+	*dx = p0->dx;
+	*dy = p0->dy;
+	return p0->len > 0.0f;
+}
+
+// Fills the gap between the fringes of the segments and curves which meet at p1, on the outer side
+// of the turn, with a wedge through the bisector. The fringes overlap on the inner side.
+static NVGvertex* nvg__curveFringeJoin(NVGvertex* dst, const NVGpoint* p0, const NVGpoint* p1, const NVGpoint* p2, float aa)
+{
+	float dx0, dy0, dx1, dy1, bx, by, cross, s;
+
+	if (!nvg__curveFillDir(p0, p1, 1, &dx0, &dy0) || !nvg__curveFillDir(p1, p2, 0, &dx1, &dy1))
+		return dst;
+	cross = nvg__cross(dx0, dy0, dx1, dy1);
+	if (nvg__absf(cross) < 0.001f && dx0*dx1 + dy0*dy1 > 0.0f)
+		return dst;
+
+	s = cross < 0.0f ? 1.0f : -1.0f;
+	bx = dx0 - dx1;
+	by = dy0 - dy1;
+	nvg__normalize(&bx, &by);
+	nvg__vset(dst, p1->x, p1->y, 0.0f, 0.0f); dst++;
+	nvg__vset(dst, p1->x + dy0*s*aa, p1->y - dx0*s*aa, 0.0f, s); dst++;
+	nvg__vset(dst, p1->x + bx*aa, p1->y + by*aa, 0.0f, s); dst++;
+	nvg__vset(dst, p1->x, p1->y, 0.0f, 0.0f); dst++;
+	nvg__vset(dst, p1->x + bx*aa, p1->y + by*aa, 0.0f, s); dst++;
+	nvg__vset(dst, p1->x + dy1*s*aa, p1->y - dx1*s*aa, 0.0f, s); dst++;
+	return dst;
+}
+
+static int nvg__expandCurveFill(NVGcontext* ctx, float aa)
+{
+	NVGpathCache* cache = ctx->cache;
+	NVGvertex* verts;
+	NVGvertex* dst;
+	int cverts, i, j;
+
+	cverts = 0;
+	for (i = 0; i < cache->npaths; i++) {
+		cverts += cache->paths[i].count;
+		if (aa > 0.0f)
+			cverts += cache->paths[i].count*12 + cache->paths[i].ncurve*2;
+	}
+
+	verts = nvg__allocTempVerts(ctx, cverts);
+	if (verts == NULL) return 0;
+
+	for (i = 0; i < cache->npaths; i++) {
+		NVGpath* path = &cache->paths[i];
+		NVGpoint* pts = &cache->points[path->first];
+		NVGpoint* p0;
+		NVGpoint* p1;
+
+		path->convex = 0;
+		path->triangulated = 0;
+
+		// Interior vertices, the curve test in the stencil pass keeps them.
+		dst = verts;
+		path->fill = dst;
+		for (j = 0; j < path->count; ++j) {
+			nvg__vset(dst, pts[j].x, pts[j].y, 0.0f, 0.0f);
+			dst++;
+		}
+		path->nfill = (int)(dst - verts);
+		verts = dst;
+
+		if (aa > 0.0f) {
 			dst = verts;
 			path->stroke = dst;
-
-			// Create only half a fringe for convex shapes so that
-			// the shape can be rendered without stenciling.
-			if (convex) {
-				lw = woff;	// This should generate the same vertex as fill inset above.
-				lu = 0.5f;	// Set outline fade at middle.
-			}
-
-			// Looping
 			p0 = &pts[path->count-1];
 			p1 = &pts[0];
-
 			for (j = 0; j < path->count; ++j) {
-				if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0) {
-					dst = nvg__bevelJoin(dst, p0, p1, lw, rw, lu, ru, ctx->fringeWidth);
-				} else {
-					nvg__vset(dst, p1->x + (p1->dmx * lw), p1->y + (p1->dmy * lw), lu,1); dst++;
-					nvg__vset(dst, p1->x - (p1->dmx * rw), p1->y - (p1->dmy * rw), ru,1); dst++;
+				if ((p0->flags & NVG_PT_CHORD) == 0 && p0->len > 0.0f) {
+					float nx = p0->dy * aa, ny = -p0->dx * aa;
+					nvg__vset(dst, p0->x + nx, p0->y + ny, 0.0f, 1.0f); dst++;
+					nvg__vset(dst, p0->x - nx, p0->y - ny, 0.0f, -1.0f); dst++;
+					nvg__vset(dst, p1->x + nx, p1->y + ny, 0.0f, 1.0f); dst++;
+					nvg__vset(dst, p1->x + nx, p1->y + ny, 0.0f, 1.0f); dst++;
+					nvg__vset(dst, p0->x - nx, p0->y - ny, 0.0f, -1.0f); dst++;
+					nvg__vset(dst, p1->x - nx, p1->y - ny, 0.0f, -1.0f); dst++;
 				}
+				dst = nvg__curveFringeJoin(dst, p0, p1, &pts[(j+1) % path->count], aa);
 				p0 = p1++;
 			}
-
-			// Loop it
-			nvg__vset(dst, verts[0].x, verts[0].y, lu,1); dst++;
-			nvg__vset(dst, verts[1].x, verts[1].y, ru,1); dst++;
-
+			for (j = 0; j < path->ncurve; j += 3)
+				dst = nvg__curveFringe(dst, &path->curve[j], aa);
 			path->nstroke = (int)(dst - verts);
 			verts = dst;
 		} else {
@@ -1966,6 +3155,7 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 void nvgBeginPath(NVGcontext* ctx)
 {
 	ctx->ncommands = 0;
+	ctx->shapeCommands = 0;
 	nvg__clearPathCache(ctx);
 }
 
@@ -2131,8 +3321,34 @@ void nvgArc(NVGcontext* ctx, float cx, float cy, float r, float a0, float a1, in
 	nvg__appendCommands(ctx, vals, nvals);
 }
 
+// Remembers the shape if it is the first one in the path, and the transform keeps it a shape.
+// It stays valid until more commands are added to the path.
+static void nvg__recordShape(NVGcontext* ctx, int ncommands, int type, float cx, float cy, float ex, float ey, float radius)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float* t = state->xform;
+	float sx = t[0]*t[0] + t[1]*t[1];
+	float sy = t[2]*t[2] + t[3]*t[3];
+
+	if (ncommands != 0 || ex <= 0.0f || ey <= 0.0f || sx <= 0.0f)
+		return;
+	if (nvg__absf(sx - sy) > sx*1e-4f || nvg__absf(t[0]*t[2] + t[1]*t[3]) > sx*1e-4f)
+		return;
+
+	ctx->shape.type = type;
+	ctx->shape.xform[0] = t[0]; ctx->shape.xform[1] = t[1];
+	ctx->shape.xform[2] = t[2]; ctx->shape.xform[3] = t[3];
+	ctx->shape.xform[4] = t[0]*cx + t[2]*cy + t[4];
+	ctx->shape.xform[5] = t[1]*cx + t[3]*cy + t[5];
+	ctx->shape.extent[0] = ex;
+	ctx->shape.extent[1] = ey;
+	ctx->shape.radius = radius;
+	ctx->shapeCommands = ctx->ncommands;
+}
+
 void nvgRect(NVGcontext* ctx, float x, float y, float w, float h)
 {
+	int ncommands = ctx->ncommands;
 	float vals[] = {
 		NVG_MOVETO, x,y,
 		NVG_LINETO, x,y+h,
@@ -2141,6 +3357,7 @@ void nvgRect(NVGcontext* ctx, float x, float y, float w, float h)
 		NVG_CLOSE
 	};
 	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
+	nvg__recordShape(ctx, ncommands, NVG_SHAPE_ROUNDRECT, x+w*0.5f, y+h*0.5f, nvg__absf(w)*0.5f, nvg__absf(h)*0.5f, 0.0f);
 }
 
 void nvgRoundedRect(NVGcontext* ctx, float x, float y, float w, float h, float r)
@@ -2172,7 +3389,12 @@ void nvgRoundedRectVarying(NVGcontext* ctx, float x, float y, float w, float h,
 			NVG_BEZIERTO, x + rxTL*(1 - NVG_KAPPA90), y, x, y + ryTL*(1 - NVG_KAPPA90), x, y + ryTL,
 			NVG_CLOSE
 		};
+		int ncommands = ctx->ncommands;
 		nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
+		// Only circular corners of the same size are shapes.
+		if (radTopLeft == radTopRight && radTopLeft == radBottomRight && radTopLeft == radBottomLeft &&
+			radTopLeft <= nvg__minf(halfw, halfh))
+			nvg__recordShape(ctx, ncommands, NVG_SHAPE_ROUNDRECT, x+w*0.5f, y+h*0.5f, halfw, halfh, radTopLeft);
 	}
 }
 
@@ -2186,7 +3408,12 @@ void nvgEllipse(NVGcontext* ctx, float cx, float cy, float rx, float ry)
 		NVG_BEZIERTO, cx-rx*NVG_KAPPA90, cy-ry, cx-rx, cy-ry*NVG_KAPPA90, cx-rx, cy,
 		NVG_CLOSE
 	};
+	int ncommands = ctx->ncommands;
 	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
+	if (rx == ry)
+		nvg__recordShape(ctx, ncommands, NVG_SHAPE_ROUNDRECT, cx, cy, rx, ry, rx);
+	else
+		nvg__recordShape(ctx, ncommands, NVG_SHAPE_ELLIPSE, cx, cy, rx, ry, 0.0f);
 }
 
 void nvgCircle(NVGcontext* ctx, float cx, float cy, float r)
@@ -2216,18 +3443,196 @@ void nvgDebugDumpPathCache(NVGcontext* ctx)
 	}
 }
 
+static int nvg__cullRect(NVGcontext* ctx, float* rect)
+{
+	NVGstate* state = nvg__getState(ctx);
+	int cull = 0;
+
+	rect[0] = -1e30f; rect[1] = -1e30f;
+	rect[2] = 1e30f; rect[3] = 1e30f;
+
+	if (ctx->viewWidth > 0.0f && ctx->viewHeight > 0.0f) {
+		rect[0] = 0.0f; rect[1] = 0.0f;
+		rect[2] = ctx->viewWidth; rect[3] = ctx->viewHeight;
+		cull = 1;
+	}
+
+	if (state->scissor.extent[0] >= 0.0f) {
+		// Axis aligned bounds of the transformed scissor rectangle.
+		float* t = state->scissor.xform;
+		float ex = state->scissor.extent[0];
+		float ey = state->scissor.extent[1];
+		float tex = ex*nvg__absf(t[0]) + ey*nvg__absf(t[2]);
+		float tey = ex*nvg__absf(t[1]) + ey*nvg__absf(t[3]);
+		rect[0] = nvg__maxf(rect[0], t[4] - tex);
+		rect[1] = nvg__maxf(rect[1], t[5] - tey);
+		rect[2] = nvg__minf(rect[2], t[4] + tex);
+		rect[3] = nvg__minf(rect[3], t[5] + tey);
+		cull = 1;
+	}
+
+	return cull;
+}
+
+static void nvg__commandBounds(NVGcontext* ctx, float* bounds)
+{
+	int i = 0, j, n;
+
+	bounds[0] = bounds[1] = 1e6f;
+	bounds[2] = bounds[3] = -1e6f;
+
+	// Commands are already transformed, and the control points enclose the curves.
+	while (i < ctx->ncommands) {
+		int cmd = (int)ctx->commands[i];
+		switch (cmd) {
+		case NVG_MOVETO:
+		case NVG_LINETO:
+			n = 1;
+			break;
+		case NVG_BEZIERTO:
+			n = 3;
+			break;
+		case NVG_WINDING:
+			i += 2;
+			continue;
+		default:
+			i++;
+			continue;
+		}
+		for (j = 0; j < n; j++) {
+			float x = ctx->commands[i+1+j*2];
+			float y = ctx->commands[i+2+j*2];
+			bounds[0] = nvg__minf(bounds[0], x);
+			bounds[1] = nvg__minf(bounds[1], y);
+			bounds[2] = nvg__maxf(bounds[2], x);
+			bounds[3] = nvg__maxf(bounds[3], y);
+		}
+		i += 1 + n*2;
+	}
+}
+
+// The path is a single shape, and the renderer can draw it.
+static int nvg__useShape(NVGcontext* ctx)
+{
+	NVGstate* state = nvg__getState(ctx);
+	return ctx->params.renderShape != NULL && ctx->shapeCommands > 0 && ctx->shapeCommands == ctx->ncommands &&
+		ctx->cache->npaths == 0 && (state->shapeAntiAlias || !ctx->params.edgeAntiAlias);
+}
+
+static int nvg__hasCurves(NVGcontext* ctx)
+{
+	int i = 0;
+	while (i < ctx->ncommands) {
+		int cmd = (int)ctx->commands[i];
+		if (cmd == NVG_BEZIERTO)
+			return 1;
+		i += cmd == NVG_MOVETO || cmd == NVG_LINETO ? 3 : cmd == NVG_WINDING ? 2 : 1;
+	}
+	return 0;
+}
+
+// Tests only the control points, for paths which are not flattened.
+static int nvg__cullCommands(NVGcontext* ctx, float margin)
+{
+	float rect[4], bounds[4];
+
+	if (!nvg__cullRect(ctx, rect))
+		return 0;
+
+	nvg__commandBounds(ctx, bounds);
+	return nvg__outsideRect(bounds, rect, margin);
+}
+
+// Returns true if the current path is outside the viewport and scissor when
+// expanded by margin. The cheap control point bounds are tested first, and the
+// path is flattened only if they are visible.
+static int nvg__cullPath(NVGcontext* ctx, float margin)
+{
+	float rect[4], bounds[4];
+
+	if (!nvg__cullRect(ctx, rect))
+		return 0;
+
+	if (ctx->cache->npaths == 0) {
+		nvg__commandBounds(ctx, bounds);
+		if (nvg__outsideRect(bounds, rect, margin))
+			return 1;
+		nvg__flattenPaths(ctx);
+	}
+
+	return nvg__outsideRect(ctx->cache->bounds, rect, margin);
+}
+
+// Clips the flattened path against the viewport and scissor expanded by margin,
+// so that the geometry generated along the clip edges stays out of view.
+static int nvg__clipPathToView(NVGcontext* ctx, float margin, int polygons)
+{
+	float rect[4];
+
+	if (!nvg__cullRect(ctx, rect))
+		return 0;
+
+	margin += 1.0f;
+	rect[0] -= margin;
+	rect[1] -= margin;
+	rect[2] += margin;
+	rect[3] += margin;
+
+	return nvg__clipPaths(ctx, rect, polygons);
+}
+
 void nvgFill(NVGcontext* ctx)
 {
 	NVGstate* state = nvg__getState(ctx);
 	const NVGpath* path;
 	NVGpaint fillPaint = state->fill;
-	int i;
+	float margin = ctx->fringeWidth * 4.0f;
+	float aa = ctx->params.edgeAntiAlias && state->shapeAntiAlias ? ctx->fringeWidth : 0.0f;
+	int i, clipped = 0, shape, curves;
 
-	nvg__flattenPaths(ctx);
-	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
-		nvg__expandFill(ctx, ctx->fringeWidth, NVG_MITER, 2.4f);
-	else
-		nvg__expandFill(ctx, 0.0f, NVG_MITER, 2.4f);
+	// Let the renderer draw shapes and curves if it can, unless the path is already flattened.
+	shape = nvg__useShape(ctx);
+	curves = !shape && ctx->params.curveFills && ctx->cache->npaths == 0 && nvg__hasCurves(ctx);
+
+	// Empty paths draw nothing, they are not counted as culled.
+	if (ctx->ncommands == 0)
+		return;
+
+	// The fill fringe and its miters extend a few pixels outside the path.
+	if (shape || curves ? nvg__cullCommands(ctx, margin) : nvg__cullPath(ctx, margin)) {
+		ctx->culledFillCount++;
+		return;
+	}
+
+	// Draw the pending text first, so that the fill stays on top of it.
+	nvg__flushText(ctx);
+
+	if (shape) {
+		fillPaint.innerColor.a *= state->alpha;
+		fillPaint.outerColor.a *= state->alpha;
+		ctx->params.renderShape(ctx->params.userPtr, &fillPaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
+								0.0f, &ctx->shape);
+		ctx->fillTriCount += 2;
+		ctx->drawCallCount++;
+		return;
+	}
+
+	if (curves) {
+		nvg__flattenCurves(ctx);
+		// Curves flat enough to be lines leave no curve triangles, fill the path as usual then.
+		curves = ctx->cache->ncurves > 0;
+		if (!curves)
+			nvg__clearPathCache(ctx);
+	}
+	if (curves) {
+		nvg__expandCurveFill(ctx, aa);
+	} else {
+		nvg__flattenPaths(ctx);
+		if (state->shapeClipping)
+			clipped = nvg__clipPathToView(ctx, margin, 1);
+
+		nvg__expandFill(ctx, aa, NVG_MITER, 2.4f);
+	}
 
 	// Apply global alpha
 	fillPaint.innerColor.a *= state->alpha;
@@ -2239,10 +3644,17 @@ void nvgFill(NVGcontext* ctx)
 	// Count triangles
 	for (i = 0; i < ctx->cache->npaths; i++) {
 		path = &ctx->cache->paths[i];
-		ctx->fillTriCount += path->nfill-2;
-		ctx->fillTriCount += path->nstroke-2;
+		ctx->fillTriCount += path->triangulated ? path->nfill/3 : path->nfill-2;
+		if (curves)
+			ctx->fillTriCount += (path->ncurve + path->nstroke) / 3;
+		else
+			ctx->fillTriCount += path->nstroke-2;
 		ctx->drawCallCount += 2;
 	}
+
+	// Clipped paths and curves cannot be reused by the next fill or stroke.
+	if (clipped || curves)
+		nvg__clearPathCache(ctx);
 }
 
 void nvgStroke(NVGcontext* ctx)
@@ -2252,9 +3664,12 @@ void nvgStroke(NVGcontext* ctx)
 	float strokeWidth = nvg__clampf(state->strokeWidth * scale, 0.0f, 200.0f);
 	NVGpaint strokePaint = state->stroke;
 	const NVGpath* path;
-	int i;
-
+	float margin;
+	int i, clipped = 0, shape, hairline;
 
+	// Strokes thinner than a pixel skip the joins and caps when they are anti-aliased, if the renderer draws hairlines.
+	hairline = ctx->params.renderHairlines != NULL && strokeWidth < ctx->fringeWidth &&
+		ctx->params.edgeAntiAlias && state->shapeAntiAlias;
 	if (strokeWidth < ctx->fringeWidth) {
 		// If the stroke width is less than pixel size, use alpha to emulate coverage.
 		// Since coverage is area, scale by alpha*alpha.
@@ -2268,22 +3683,86 @@ void nvgStroke(NVGcontext* ctx)
 	strokePaint.innerColor.a *= state->alpha;
 	strokePaint.outerColor.a *= state->alpha;
 
-	nvg__flattenPaths(ctx);
-
-	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
-		nvg__expandStroke(ctx, strokeWidth*0.5f, ctx->fringeWidth, state->lineCap, state->lineJoin, state->miterLimit);
+	// Miter joins and square caps reach further than half the stroke width.
+	margin = strokeWidth*0.5f + ctx->fringeWidth;
+	if (state->lineJoin == NVG_MITER)
+		margin *= nvg__maxf(1.5f, state->miterLimit);
 	else
-		nvg__expandStroke(ctx, strokeWidth*0.5f, 0.0f, state->lineCap, state->lineJoin, state->miterLimit);
+		margin *= 1.5f;
+	// Rect strokes are shapes only with miter joins, and ellipse strokes are not.
+	shape = state->ndashes == 0 && nvg__useShape(ctx) &&
+		(ctx->shape.type == NVG_SHAPE_ROUNDRECT && (ctx->shape.radius > 0.0f ||
+		 (state->lineJoin == NVG_MITER && state->miterLimit >= 1.4143f)));
+
+	if (ctx->ncommands == 0)
+		return;
+	if (shape ? nvg__cullCommands(ctx, margin) : nvg__cullPath(ctx, margin)) {
+		ctx->culledStrokeCount++;
+		return;
+	}
 
-	ctx->params.renderStroke(ctx->params.userPtr, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
-							 strokeWidth, ctx->cache->paths, ctx->cache->npaths);
+	// Draw the pending text first, so that the stroke stays on top of it.
+	nvg__flushText(ctx);
 
-	// Count triangles
-	for (i = 0; i < ctx->cache->npaths; i++) {
-		path = &ctx->cache->paths[i];
-		ctx->strokeTriCount += path->nstroke-2;
+	if (shape) {
+		ctx->params.renderShape(ctx->params.userPtr, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
+								strokeWidth, &ctx->shape);
+		ctx->strokeTriCount += 2;
 		ctx->drawCallCount++;
+		return;
+	}
+
+	nvg__flattenPaths(ctx);
+	if (state->ndashes > 0) {
+		float dashes[NVG_MAX_DASHES];
+		for (i = 0; i < state->ndashes; i++)
+			dashes[i] = state->dashes[i] * scale;
+		nvg__dashPaths(ctx, dashes, state->ndashes, state->dashOffset * scale, state->lineCap);
+		clipped = 1;
+	}
+	if (state->shapeClipping)
+		clipped |= nvg__clipPathToView(ctx, margin, 0);
+
+	if (hairline) {
+		nvg__expandHairline(ctx, ctx->fringeWidth, state->lineCap);
+		ctx->params.renderHairlines(ctx->params.userPtr, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
+									ctx->cache->paths, ctx->cache->npaths);
+		for (i = 0; i < ctx->cache->npaths; i++) {
+			path = &ctx->cache->paths[i];
+			ctx->strokeTriCount += nvg__maxi(path->nstroke-2, 0);
+			ctx->drawCallCount++;
+		}
+	} else if (ctx->params.renderStrokePoints != NULL && ctx->params.edgeAntiAlias && state->shapeAntiAlias &&
+		state->lineJoin == NVG_ROUND && state->lineCap == NVG_ROUND) {
+		// Let the renderer expand round strokes if it can.
+		if (nvg__strokePoints(ctx)) {
+			ctx->params.renderStrokePoints(ctx->params.userPtr, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
+										   strokeWidth, ctx->cache->paths, ctx->cache->npaths);
+			for (i = 0; i < ctx->cache->npaths; i++) {
+				path = &ctx->cache->paths[i];
+				ctx->strokeTriCount += (path->closed ? path->count : path->count-1) * 2;
+				ctx->drawCallCount++;
+			}
+		}
+	} else {
+		if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
+			nvg__expandStroke(ctx, strokeWidth*0.5f, ctx->fringeWidth, state->lineCap, state->lineJoin, state->miterLimit);
+		else
+			nvg__expandStroke(ctx, strokeWidth*0.5f, 0.0f, state->lineCap, state->lineJoin, state->miterLimit);
+
+		ctx->params.renderStroke(ctx->params.userPtr, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
+								 strokeWidth, ctx->cache->paths, ctx->cache->npaths);
+
+		// Count triangles
+		for (i = 0; i < ctx->cache->npaths; i++) {
+			path = &ctx->cache->paths[i];
+			ctx->strokeTriCount += path->nstroke-2;
+			ctx->drawCallCount++;
+		}
 	}
+
+	if (clipped)
+		nvg__clearPathCache(ctx);
 }
 
 // Add fonts
@@ -2358,6 +3837,136 @@ void nvgFontFace(NVGcontext* ctx, const char* font)
 	state->fontId = fonsGetFontByName(ctx->fs, font);
 }
 
+void nvgFontZoomBuckets(NVGcontext* ctx, int steps)
+{
+	fonsSetSizeBuckets(ctx->fs, steps);
+}
+
+void nvgGlyphBudget(NVGcontext* ctx, int glyphs)
+{
+	fonsSetGlyphBudget(ctx->fs, glyphs);
+}
+
+#ifndef NVG_NO_THREADS
+static void nvg__prewarmWork(NVGcontext* ctx)
+{
+	nvg__lock(&ctx->prewarmLock);
+	while (!ctx->prewarmQuit) {
+		NVGprewarm* p;
+		int i;
+		for (p = ctx->prewarms; p != NULL; p = p->link) {
+			if (p->next < fonsPrewarmCount(p->glyphs)) break;
+		}
+		if (p == NULL) {
+			nvg__condWait(&ctx->prewarmCond, &ctx->prewarmLock);
+			continue;
+		}
+		// The batch stays queued until its last glyph is done.
+		i = p->next++;
+		nvg__unlock(&ctx->prewarmLock);
+		fonsPrewarmRasterize(p->glyphs, i);
+		nvg__lock(&ctx->prewarmLock);
+		p->done++;
+	}
+	nvg__unlock(&ctx->prewarmLock);
+}
+#endif
+
+// Adds the glyphs of the finished batches to the atlas, they are uploaded at the end of the frame.
+// The batches are packed in order, so the glyphs are placed like they would be when drawn.
+static void nvg__packPrewarmed(NVGcontext* ctx)
+{
+	NVGprewarm* done = NULL;
+	NVGprewarm** link;
+
+	if (ctx->prewarms == NULL) return;
+
+	nvg__lock(&ctx->prewarmLock);
+	for (link = &ctx->prewarms; *link != NULL && (*link)->done == fonsPrewarmCount((*link)->glyphs); link = &(*link)->link);
+	if (link != &ctx->prewarms) {
+		// Split the finished batches from the queue.
+		done = ctx->prewarms;
+		ctx->prewarms = *link;
+		*link = NULL;
+	}
+	nvg__unlock(&ctx->prewarmLock);
+
+	while (done != NULL) {
+		NVGprewarm* p = done;
+		done = p->link;
+		fonsPrewarmEnd(ctx->fs, p->glyphs);
+		free(p);
+	}
+}
+
+int nvgPrewarmGlyphs(NVGcontext* ctx, int font, float size, const unsigned int* codepoints, int n)
+{
+	NVGprewarm* p;
+	NVGprewarm** link;
+	FONSprewarm* glyphs;
+	int i, count;
+
+	if (font == FONS_INVALID) return 0;
+
+	fonsSetFont(ctx->fs, font);
+	fonsSetSize(ctx->fs, size*ctx->devicePxRatio);
+	fonsSetBlur(ctx->fs, 0.0f);
+	glyphs = fonsPrewarmBegin(ctx->fs, codepoints, n);
+	count = fonsPrewarmCount(glyphs);
+	if (count == 0) {
+		fonsPrewarmFree(glyphs);
+		return 0;
+	}
+
+	p = (NVGprewarm*)malloc(sizeof(NVGprewarm));
+	if (p == NULL) {
+		fonsPrewarmFree(glyphs);
+		return 0;
+	}
+	memset(p, 0, sizeof(NVGprewarm));
+	p->glyphs = glyphs;
+
+	// Start the workers on first use.
+	while (ctx->nthreads < NVG_PREWARM_THREADS && nvg__threadStart(&ctx->threads[ctx->nthreads], ctx))
+		ctx->nthreads++;
+	if (ctx->nthreads == 0) {
+		for (i = 0; i < count; i++)
+			fonsPrewarmRasterize(glyphs, i);
+		p->next = p->done = count;
+	}
+
+	nvg__lock(&ctx->prewarmLock);
+	for (link = &ctx->prewarms; *link != NULL; link = &(*link)->link);
+	*link = p;
+	nvg__condBroadcast(&ctx->prewarmCond);
+	nvg__unlock(&ctx->prewarmLock);
+
+	return count;
+}
+
+int nvgPrewarmText(NVGcontext* ctx, int font, float size, const char* string, const char* end)
+{
+	unsigned int utf8state = 0, codepoint = 0;
+	unsigned int* codepoints;
+	int n = 0;
+
+	if (end == NULL)
+		end = string + strlen(string);
+	if (end == string) return 0;
+
+	codepoints = (unsigned int*)malloc(sizeof(unsigned int) * (end - string));
+	if (codepoints == NULL) return 0;
+	for (; string != end; string++) {
+		if (fons__decutf8(&utf8state, &codepoint, *(const unsigned char*)string))
+			continue;
+		codepoints[n++] = codepoint;
+	}
+	n = nvgPrewarmGlyphs(ctx, font, size, codepoints, n);
+	free(codepoints);
+
+	return n;
+}
+
 static float nvg__quantize(float a, float d)
 {
 	return ((int)(a / d + 0.5f)) * d;
@@ -2368,132 +3977,302 @@ static float nvg__getFontScale(NVGstate* state)
 	return nvg__minf(nvg__quantize(nvg__getAverageScale(state->xform), 0.01f), 4.0f);
 }
 
-static void nvg__flushTextTexture(NVGcontext* ctx)
+// Merges the rects which share rows, until none do.
+static int nvg__mergeRowRects(int* rects, int n)
 {
-	int dirty[4];
+	int i, j, merged = 1;
+	while (merged) {
+		merged = 0;
+		for (i = 0; i < n; i++) {
+			for (j = i+1; j < n; j++) {
+				int* a = &rects[i*4];
+				int* b = &rects[j*4];
+				if (a[1] >= b[3] || b[1] >= a[3])
+					continue;
+				a[0] = nvg__mini(a[0], b[0]);
+				a[1] = nvg__mini(a[1], b[1]);
+				a[2] = nvg__maxi(a[2], b[2]);
+				a[3] = nvg__maxi(a[3], b[3]);
+				memmove(b, &rects[(n-1)*4], sizeof(int)*4);
+				n--;
+				j--;
+				merged = 1;
+			}
+		}
+	}
+	return n;
+}
 
-	if (fonsValidateTexture(ctx->fs, dirty)) {
-		int fontImage = ctx->fontImages[ctx->fontImageIdx];
-		// Update texture
-		if (fontImage != 0) {
-			int iw, ih;
-			const unsigned char* data = fonsGetTextureData(ctx->fs, &iw, &ih);
-			int x = dirty[0];
-			int y = dirty[1];
-			int w = dirty[2] - dirty[0];
-			int h = dirty[3] - dirty[1];
-			ctx->params.renderUpdateTexture(ctx->params.userPtr, fontImage, x,y, w,h, data);
+static void nvg__flushTextTexture(NVGcontext* ctx)
+{
+	int i, j, n, dirty[FONS_MAX_DIRTY_RECTS*4];
+
+	for (i = 0; i < fonsGetPageCount(ctx->fs); i++) {
+		int fontImage = ctx->fontImages[i];
+		int iw, ih;
+		const unsigned char* data = fonsGetPageData(ctx->fs, i, &iw, &ih);
+		if (fontImage == 0) continue;
+		// Update texture, each changed region separately.
+		n = fonsValidatePageRects(ctx->fs, i, dirty);
+		// Rects sharing rows would upload the same rows twice.
+		if (ctx->params.rowUpdates)
+			n = nvg__mergeRowRects(dirty, n);
+		for (j = 0; j < n; j++) {
+			int* r = &dirty[j*4];
+			ctx->params.renderUpdateTexture(ctx->params.userPtr, fontImage, r[0],r[1], r[2]-r[0],r[3]-r[1], data);
 		}
 	}
 }
 
-static int nvg__allocTextAtlas(NVGcontext* ctx)
+static int nvg__fontImage(NVGcontext* ctx, int page)
 {
-	int iw, ih;
-	nvg__flushTextTexture(ctx);
-	if (ctx->fontImageIdx >= NVG_MAX_FONTIMAGES-1)
-		return 0;
-	// if next fontImage already have a texture
-	if (ctx->fontImages[ctx->fontImageIdx+1] != 0)
-		nvgImageSize(ctx, ctx->fontImages[ctx->fontImageIdx+1], &iw, &ih);
-	else { // calculate the new font image size and create it.
-		nvgImageSize(ctx, ctx->fontImages[ctx->fontImageIdx], &iw, &ih);
-		if (iw > ih)
-			ih *= 2;
-		else
-			iw *= 2;
-		if (iw > NVG_MAX_FONTIMAGE_SIZE || ih > NVG_MAX_FONTIMAGE_SIZE)
-			iw = ih = NVG_MAX_FONTIMAGE_SIZE;
-		ctx->fontImages[ctx->fontImageIdx+1] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, iw, ih, 0, NULL);
+	if (ctx->fontImages[page] == 0) {
+		// Create texture for a new atlas page, later changes are uploaded at the end of the frame.
+		int iw, ih, dirty[4];
+		const unsigned char* data = fonsGetPageData(ctx->fs, page, &iw, &ih);
+		ctx->fontImages[page] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, iw, ih, ctx->fontImageFlags, data);
+		fonsValidatePage(ctx->fs, page, dirty);
 	}
-	++ctx->fontImageIdx;
-	fonsResetAtlas(ctx->fs, iw, ih);
-	return 1;
+	return ctx->fontImages[page];
+}
+
+static void nvg__flushText(NVGcontext* ctx)
+{
+	if (ctx->ntextVerts == 0) return;
+
+	ctx->params.renderTriangles(ctx->params.userPtr, &ctx->textPaint, ctx->textCompositeOperation, &ctx->textScissor,
+								ctx->textVerts, ctx->ntextVerts);
+
+	ctx->drawCallCount++;
+	ctx->textTriCount += ctx->ntextVerts/3;
+	ctx->ntextVerts = 0;
 }
 
-static void nvg__renderText(NVGcontext* ctx, NVGvertex* verts, int nverts)
+static void nvg__renderText(NVGcontext* ctx, NVGvertex* verts, int nverts, int page)
 {
 	NVGstate* state = nvg__getState(ctx);
 	NVGpaint paint = state->fill;
 
 	// Render triangles.
-	paint.image = ctx->fontImages[ctx->fontImageIdx];
+	paint.image = nvg__fontImage(ctx, page);
+	if ((ctx->fontImageFlags & NVG_IMAGE_SDF) && !fonsGetSDFParams(ctx->fs, &paint.radius, &paint.feather)) {
+		// Coverage glyphs in an atlas with distance fields, map the value to itself.
+		paint.radius = 0.5f;
+		paint.feather = 1.0f;
+	}
 
 	// Apply global alpha
 	paint.innerColor.a *= state->alpha;
 	paint.outerColor.a *= state->alpha;
 
-	ctx->params.renderTriangles(ctx->params.userPtr, &paint, state->compositeOperation, &state->scissor, verts, nverts);
+	// Text with the same paint, blending and scissor as the pending text is drawn with it.
+	if (ctx->ntextVerts > 0 &&
+		(memcmp(&paint, &ctx->textPaint, sizeof(NVGpaint)) != 0 ||
+		 memcmp(&state->compositeOperation, &ctx->textCompositeOperation, sizeof(NVGcompositeOperationState)) != 0 ||
+		 memcmp(&state->scissor, &ctx->textScissor, sizeof(NVGscissor)) != 0))
+		nvg__flushText(ctx);
+
+	if (ctx->ntextVerts + nverts > ctx->ctextVerts) {
+		int ctextVerts = nvg__maxi(ctx->ntextVerts + nverts, 256) + ctx->ctextVerts/2; // 1.5x Overallocate
+		NVGvertex* textVerts = (NVGvertex*)realloc(ctx->textVerts, sizeof(NVGvertex)*ctextVerts);
+		if (textVerts == NULL) return;
+		ctx->textVerts = textVerts;
+		ctx->ctextVerts = ctextVerts;
+	}
+	memcpy(&ctx->textVerts[ctx->ntextVerts], verts, sizeof(NVGvertex)*nverts);
+	ctx->ntextVerts += nverts;
+	ctx->textPaint = paint;
+	ctx->textCompositeOperation = state->compositeOperation;
+	ctx->textScissor = state->scissor;
+}
 
-	ctx->drawCallCount++;
-	ctx->textTriCount += nverts/3;
+static unsigned int nvg__hashText(const char* str, const char* end, int fontId, float size)
+{
+	// FNV-1a
+	unsigned int h = 2166136261u;
+	for (; str != end; str++) {
+		h ^= *(const unsigned char*)str;
+		h *= 16777619u;
+	}
+	h ^= (unsigned int)fontId;
+	h *= 16777619u;
+	h ^= (unsigned int)(size*10.0f);
+	h *= 16777619u;
+	return h;
 }
 
-float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char* end)
+// Returns the quads of the string at the current font, shaping it only if the cached run
+// is missing or its quads are no longer valid.
+static NVGtextRun* nvg__getTextRun(NVGcontext* ctx, const char* string, const char* end, float size, float spacing, float blur)
 {
 	NVGstate* state = nvg__getState(ctx);
-	FONStextIter iter, prevIter;
+	int len = (int)(end - string);
+	unsigned int hash = nvg__hashText(string, end, state->fontId, size);
+	NVGtextRun* run = &ctx->textRuns[hash & (NVG_TEXT_RUNS-1)];
+	FONStextIter iter;
 	FONSquad q;
+	int valid = 1;
+	int deferred = 0, ndeferred = 0;
+
+	if (run->generation == fonsGetAtlasGeneration(ctx->fs) && run->hash == hash && run->len == len &&
+		run->fontId == state->fontId && run->size == size && run->spacing == spacing && run->blur == blur &&
+		(len == 0 || memcmp(run->str, string, len) == 0)) {
+		// Keep the pages of the quads from being evicted during this frame.
+		fonsTouchPages(ctx->fs, run->pages);
+		return run;
+	}
+
+	if (len > run->cstr) {
+		char* str = (char*)realloc(run->str, len);
+		if (str == NULL) return NULL;
+		run->str = str;
+		run->cstr = len;
+	}
+	if (len > run->cquads) {
+		FONSquad* quads = (FONSquad*)realloc(run->quads, sizeof(FONSquad)*len);
+		if (quads == NULL) return NULL;
+		run->quads = quads;
+		run->cquads = len;
+	}
+	if (len > 0)
+		memcpy(run->str, string, len);
+	run->len = len;
+	run->hash = hash;
+	run->fontId = state->fontId;
+	run->size = size;
+	run->spacing = spacing;
+	run->blur = blur;
+	run->snapped = 1;
+	run->pages = 0;
+	run->nquads = 0;
+
+	// Shape at the origin, the quads are positioned when drawn.
+	fonsGetGlyphStats(ctx->fs, NULL, &deferred);
+	fonsTextIterInit(ctx->fs, &iter, 0, 0, string, end, FONS_GLYPH_BITMAP_REQUIRED);
+	while (fonsTextIterNext(ctx->fs, &iter, &q)) {
+		if (iter.prevGlyphIndex == -1) { // can not retrieve glyph?
+			valid = 0;
+			continue;
+		}
+		if (q.x0 == q.x1) // glyph deferred by the budget, without placeholder
+			continue;
+		run->quads[run->nquads++] = q;
+		run->pages |= 1u << q.page;
+		run->snapped = iter.snapped;
+	}
+	run->advance = iter.nextx;
+	// Shape again next time if some glyphs did not fit into the atlas or were deferred by the budget.
+	fonsGetGlyphStats(ctx->fs, NULL, &ndeferred);
+	if (ndeferred != deferred)
+		valid = 0;
+	run->generation = valid ? fonsGetAtlasGeneration(ctx->fs) : -1;
+
+	return run;
+}
+
+float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char* end)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGtextRun* run;
+	FONStextIter iter;
 	NVGvertex* verts;
 	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
 	float invscale = 1.0f / scale;
+	float rect[4];
+	float ox, oy;
+	int cull;
 	int cverts = 0;
 	int nverts = 0;
+	int page = 0;
+	int i;
 
 	if (end == NULL)
 		end = string + strlen(string);
 
 	if (state->fontId == FONS_INVALID) return x;
 
+	cull = nvg__cullRect(ctx, rect);
+
 	fonsSetSize(ctx->fs, state->fontSize*scale);
 	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
 	fonsSetBlur(ctx->fs, state->fontBlur*scale);
-	fonsSetAlign(ctx->fs, state->textAlign);
+	fonsSetAlign(ctx->fs, NVG_ALIGN_LEFT | NVG_ALIGN_BASELINE);
 	fonsSetFont(ctx->fs, state->fontId);
 
-	cverts = nvg__maxi(2, (int)(end - string)) * 6; // conservative estimate.
+	run = nvg__getTextRun(ctx, string, end, state->fontSize*scale, state->letterSpacing*scale, state->fontBlur*scale);
+	if (run == NULL) return x;
+
+	// Align the run, an empty iterator applies the vertical alignment of the font.
+	fonsSetAlign(ctx->fs, NVG_ALIGN_LEFT | (state->textAlign & (NVG_ALIGN_TOP|NVG_ALIGN_MIDDLE|NVG_ALIGN_BOTTOM|NVG_ALIGN_BASELINE)));
+	fonsTextIterInit(ctx->fs, &iter, x*scale, y*scale, string, string, FONS_GLYPH_BITMAP_OPTIONAL);
+	ox = iter.x;
+	oy = iter.y;
+	if (state->textAlign & NVG_ALIGN_LEFT) {
+		// empty
+	} else if (state->textAlign & NVG_ALIGN_RIGHT) {
+		ox -= run->advance;
+	} else if (state->textAlign & NVG_ALIGN_CENTER) {
+		ox -= run->advance * 0.5f;
+	}
+
+	cverts = nvg__maxi(2, run->nquads) * 6;
 	verts = nvg__allocTempVerts(ctx, cverts);
 	if (verts == NULL) return x;
 
-	fonsTextIterInit(ctx->fs, &iter, x*scale, y*scale, string, end, FONS_GLYPH_BITMAP_REQUIRED);
-	prevIter = iter;
-	while (fonsTextIterNext(ctx->fs, &iter, &q)) {
+	for (i = 0; i < run->nquads; i++) {
+		FONSquad* q = &run->quads[i];
 		float c[4*2];
-		if (iter.prevGlyphIndex == -1) { // can not retrieve glyph?
+		float x0, y0, x1, y1;
+		if (q->page != page) {
+			// Glyphs on another atlas page need a draw call of their own.
 			if (nverts != 0) {
-				nvg__renderText(ctx, verts, nverts);
+				nvg__renderText(ctx, verts, nverts, page);
 				nverts = 0;
 			}
-			if (!nvg__allocTextAtlas(ctx))
-				break; // no memory :(
-			iter = prevIter;
-			fonsTextIterNext(ctx->fs, &iter, &q); // try again
-			if (iter.prevGlyphIndex == -1) // still can not find glyph?
-				break;
+			page = q->page;
 		}
-		prevIter = iter;
+		// Position the quad, snapping it the same way as the font stash does.
+		if (run->snapped) {
+			x0 = (float)(int)(ox + q->x0);
+			y0 = (float)(int)(oy + q->y0);
+		} else {
+			x0 = ox + q->x0;
+			y0 = oy + q->y0;
+		}
+		x1 = x0 + (q->x1 - q->x0);
+		y1 = y0 + (q->y1 - q->y0);
 		// Transform corners.
-		nvgTransformPoint(&c[0],&c[1], state->xform, q.x0*invscale, q.y0*invscale);
-		nvgTransformPoint(&c[2],&c[3], state->xform, q.x1*invscale, q.y0*invscale);
-		nvgTransformPoint(&c[4],&c[5], state->xform, q.x1*invscale, q.y1*invscale);
-		nvgTransformPoint(&c[6],&c[7], state->xform, q.x0*invscale, q.y1*invscale);
+		nvgTransformPoint(&c[0],&c[1], state->xform, x0*invscale, y0*invscale);
+		nvgTransformPoint(&c[2],&c[3], state->xform, x1*invscale, y0*invscale);
+		nvgTransformPoint(&c[4],&c[5], state->xform, x1*invscale, y1*invscale);
+		nvgTransformPoint(&c[6],&c[7], state->xform, x0*invscale, y1*invscale);
+		// Skip glyphs outside the viewport and scissor.
+		if (cull) {
+			float bounds[4];
+			bounds[0] = nvg__minf(nvg__minf(c[0], c[2]), nvg__minf(c[4], c[6]));
+			bounds[1] = nvg__minf(nvg__minf(c[1], c[3]), nvg__minf(c[5], c[7]));
+			bounds[2] = nvg__maxf(nvg__maxf(c[0], c[2]), nvg__maxf(c[4], c[6]));
+			bounds[3] = nvg__maxf(nvg__maxf(c[1], c[3]), nvg__maxf(c[5], c[7]));
+			if (nvg__outsideRect(bounds, rect, 0.0f)) {
+				ctx->culledGlyphCount++;
+				continue;
+			}
+		}
 		// Create triangles
 		if (nverts+6 <= cverts) {
-			nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
-			nvg__vset(&verts[nverts], c[2], c[3], q.s1, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[6], c[7], q.s0, q.t1); nverts++;
-			nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
+			nvg__vset(&verts[nverts], c[0], c[1], q->s0, q->t0); nverts++;
+			nvg__vset(&verts[nverts], c[4], c[5], q->s1, q->t1); nverts++;
+			nvg__vset(&verts[nverts], c[2], c[3], q->s1, q->t0); nverts++;
+			nvg__vset(&verts[nverts], c[0], c[1], q->s0, q->t0); nverts++;
+			nvg__vset(&verts[nverts], c[6], c[7], q->s0, q->t1); nverts++;
+			nvg__vset(&verts[nverts], c[4], c[5], q->s1, q->t1); nverts++;
 		}
 	}
 
-	// TODO: add back-end bit to do this just once per frame.
-	nvg__flushTextTexture(ctx);
-
-	nvg__renderText(ctx, verts, nverts);
+	if (nverts > 0)
+		nvg__renderText(ctx, verts, nverts, page);
 
-	return iter.nextx / scale;
+	return (ox + run->advance) / scale;
 }
 
 void nvgTextBox(NVGcontext* ctx, float x, float y, float breakRowWidth, const char* string, const char* end)
@@ -2534,7 +4313,7 @@ int nvgTextGlyphPositions(NVGcontext* ctx, float x, float y, const char* string,
 	NVGstate* state = nvg__getState(ctx);
 	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
 	float invscale = 1.0f / scale;
-	FONStextIter iter, prevIter;
+	FONStextIter iter;
 	FONSquad q;
 	int npos = 0;
 
@@ -2553,13 +4332,7 @@ int nvgTextGlyphPositions(NVGcontext* ctx, float x, float y, const char* string,
 	fonsSetFont(ctx->fs, state->fontId);
 
 	fonsTextIterInit(ctx->fs, &iter, x*scale, y*scale, string, end, FONS_GLYPH_BITMAP_OPTIONAL);
-	prevIter = iter;
 	while (fonsTextIterNext(ctx->fs, &iter, &q)) {
-		if (iter.prevGlyphIndex < 0 && nvg__allocTextAtlas(ctx)) { // can not retrieve glyph?
-			iter = prevIter;
-			fonsTextIterNext(ctx->fs, &iter, &q); // try again
-		}
-		prevIter = iter;
 		positions[npos].str = iter.str;
 		positions[npos].x = iter.x * invscale;
 		positions[npos].minx = nvg__minf(iter.x, q.x0) * invscale;
@@ -2584,7 +4357,7 @@ int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, floa
 	NVGstate* state = nvg__getState(ctx);
 	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
 	float invscale = 1.0f / scale;
-	FONStextIter iter, prevIter;
+	FONStextIter iter;
 	FONSquad q;
 	int nrows = 0;
 	float rowStartX = 0;
@@ -2619,13 +4392,7 @@ int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, floa
 	breakRowWidth *= scale;
 
 	fonsTextIterInit(ctx->fs, &iter, 0, 0, string, end, FONS_GLYPH_BITMAP_OPTIONAL);
-	prevIter = iter;
 	while (fonsTextIterNext(ctx->fs, &iter, &q)) {
-		if (iter.prevGlyphIndex < 0 && nvg__allocTextAtlas(ctx)) { // can not retrieve glyph?
-			iter = prevIter;
-			fonsTextIterNext(ctx->fs, &iter, &q); // try again
-		}
-		prevIter = iter;
 		switch (iter.codepoint) {
 			case 9:			// \t
 			case 11:		// \v
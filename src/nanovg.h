@@ -135,6 +135,19 @@ struct NVGtextRow {
 };
 typedef struct NVGtextRow NVGtextRow;
 
+struct NVGframeStats {
+	int drawCallCount;		// Number of draw calls passed to the renderer.
+	int fillTriCount;		// Number of triangles generated for fills.
+	int strokeTriCount;		// Number of triangles generated for strokes.
+	int textTriCount;		// Number of triangles generated for text.
+	int culledFillCount;	// Number of fills rejected because they were outside the viewport or scissor.
+	int culledStrokeCount;	// Number of strokes rejected because they were outside the viewport or scissor.
+	int culledGlyphCount;	// Number of glyphs rejected because they were outside the viewport or scissor.
+	int rasterizedGlyphCount;	// Number of glyphs rasterized into the font atlas.
+	int deferredGlyphCount;	// Number of glyph lookups left to a later frame by nvgGlyphBudget().
+};
+typedef struct NVGframeStats NVGframeStats;
+
 enum NVGimageFlags {
     NVG_IMAGE_GENERATE_MIPMAPS	= 1<<0,     // Generate mipmaps during creation of the image.
 	NVG_IMAGE_REPEATX			= 1<<1,		// Repeat image in X direction.
@@ -142,6 +155,7 @@ enum NVGimageFlags {
 	NVG_IMAGE_FLIPY				= 1<<3,		// Flips (inverses) image in Y direction when rendered.
 	NVG_IMAGE_PREMULTIPLIED		= 1<<4,		// Image data has premultiplied alpha.
 	NVG_IMAGE_NEAREST			= 1<<5,		// Image interpolation is Nearest instead Linear
+	NVG_IMAGE_SDF				= 1<<6,		// Alpha image is a distance field, coverage is (value - paint radius) * paint feather + 0.5.
 };
 
 // Begin drawing a new frame
@@ -160,6 +174,10 @@ void nvgCancelFrame(NVGcontext* ctx);
 // Ends drawing flushing remaining render state.
 void nvgEndFrame(NVGcontext* ctx);
 
+// Returns statistics of the current frame. The counters are reset in nvgBeginFrame(),
+// so calling this after nvgEndFrame() returns the numbers of the frame just drawn.
+void nvgFrameStats(NVGcontext* ctx, NVGframeStats* stats);
+
 //
 // Composite operation
 //
@@ -241,6 +259,11 @@ void nvgReset(NVGcontext* ctx);
 // Sets whether to draw antialias for nvgStroke() and nvgFill(). It's enabled by default.
 void nvgShapeAntiAlias(NVGcontext* ctx, int enabled);
 
+// Sets whether nvgStroke() and nvgFill() clip the flattened path against the viewport and
+// scissor before generating geometry. Helps with very large paths that are mostly out of view,
+// but costs time on paths which are visible. It's disabled by default.
+void nvgShapeClipping(NVGcontext* ctx, int enabled);
+
 // Sets current stroke style to a solid color.
 void nvgStrokeColor(NVGcontext* ctx, NVGcolor color);
 
@@ -268,6 +291,13 @@ void nvgLineCap(NVGcontext* ctx, int cap);
 // Can be one of NVG_MITER (default), NVG_ROUND, NVG_BEVEL.
 void nvgLineJoin(NVGcontext* ctx, int join);
 
+// Sets the dash pattern of strokes. The pattern is an array of n dash and gap lengths which is
+// repeated along the path, if n is odd the pattern is repeated twice to make it even.
+// Offset sets how far into the pattern the stroke starts. Set n to 0 to draw solid strokes (default).
+// Zero length dashes draw dots with round or square caps. Patterns longer than 16 lengths, after
+// repeating the odd ones, are ignored and draw solid strokes.
+void nvgLineDash(NVGcontext* ctx, const float* pattern, int n, float offset);
+
 // Sets the transparency applied to all rendered shapes.
 // Already transparent paths will get proportionally more transparent as well.
 void nvgGlobalAlpha(NVGcontext* ctx, float alpha);
@@ -580,6 +610,26 @@ void nvgFontFaceId(NVGcontext* ctx, int font);
 // Sets the font face based on specified name of current text style.
 void nvgFontFace(NVGcontext* ctx, const char* font);
 
+// Rasterizes glyphs only at sizes of a geometric series with the given steps per octave, e.g. 8,
+// and scales them to the size of the text. Enable it while zooming to stop creating a glyph set
+// per frame, and set it back to 0 once the zoom settles to rasterize at the exact size again.
+void nvgFontZoomBuckets(NVGcontext* ctx, int steps);
+
+// Rasterizes at most the given number of new glyphs per frame, 0 for no limit (default). Glyphs over
+// the budget are drawn scaled from another size in the atlas, or left out, and are rasterized during
+// the following frames. Keep redrawing while NVGframeStats.deferredGlyphCount is not zero.
+void nvgGlyphBudget(NVGcontext* ctx, int glyphs);
+
+// Rasterizes the glyphs of the code points at the font and size on worker threads, and adds them
+// to the atlas at the start of a later frame, so that the first frame showing them does not stall.
+// Call it e.g. during loading screens or idle frames. The size is scaled by the device pixel ratio
+// of the current frame, like the one of nvgFontSize(). Returns the number of glyphs queued.
+// Define NVG_NO_THREADS when compiling nanovg.c to rasterize on the calling thread instead.
+int nvgPrewarmGlyphs(NVGcontext* ctx, int font, float size, const unsigned int* codepoints, int n);
+
+// Like nvgPrewarmGlyphs(), for the code points of an UTF-8 string.
+int nvgPrewarmText(NVGcontext* ctx, int font, float size, const char* string, const char* end);
+
 // Draws text string at specified location. If end is specified only the sub-string up to the end is drawn.
 float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char* end);
 
@@ -641,13 +691,40 @@ struct NVGpath {
 	NVGvertex* stroke;
 	int nstroke;
 	int winding;
-	int convex;
+	int convex;		// Convex and not overlapping the other paths, can be filled without stencil.
+	// Set only for fills of renderers with triangulateFills, fill is then a triangle list of a simple
+	// polygon that does not overlap the other paths, and can be filled without stencil.
+	int triangulated;
+	float bounds[4];
+	// Set only for fills of renderers with curveFills. When a path of the fill has curves, the fill is
+	// a curve fill and stroke is a triangle list of the fringes.
+	// Triangles between the chords of the path and its curves, inside of the curve u*u - v < 0.
+	NVGvertex* curve;
+	int ncurve;
 };
 typedef struct NVGpath NVGpath;
 
+enum NVGshapeType {
+	NVG_SHAPE_ROUNDRECT,	// Sharp corners when radius is 0, circles have radius equal to the extent.
+	NVG_SHAPE_ELLIPSE,
+};
+
+struct NVGshape {
+	int type;
+	float xform[6];		// Shape space to screen, only rotation, uniform scale and translation.
+	float extent[2];	// Half of the size, the shape is centered at origin.
+	float radius;
+};
+typedef struct NVGshape NVGshape;
+
 struct NVGparams {
 	void* userPtr;
 	int edgeAntiAlias;
+	int curveFills;
+	int triangulateFills;
+	int sdfText;	// Text is drawn from distance field glyphs, the back-end supports NVG_IMAGE_SDF.
+	int sdfBlur;	// Only blurred text is drawn from distance field glyphs, the font atlas is flagged NVG_IMAGE_SDF.
+	int rowUpdates;	// renderUpdateTexture uploads whole rows of the texture.
 	int (*renderCreate)(void* uptr);
 	int (*renderCreateTexture)(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data);
 	int (*renderDeleteTexture)(void* uptr, int image);
@@ -658,7 +735,14 @@ struct NVGparams {
 	void (*renderFlush)(void* uptr);
 	void (*renderFill)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe, const float* bounds, const NVGpath* paths, int npaths);
 	void (*renderStroke)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe, float strokeWidth, const NVGpath* paths, int npaths);
+	// Optional. Draws anti-aliased strokes with round joins and caps, path->stroke holds the flattened points of each path.
+	void (*renderStrokePoints)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe, float strokeWidth, const NVGpath* paths, int npaths);
+	// Optional. Draws strokes thinner than a pixel, path->stroke holds a strip with one quad per segment
+	// where u goes from 0 to 1 across the stroke. Thin strokes are expanded as usual when not set.
+	void (*renderHairlines)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe, const NVGpath* paths, int npaths);
 	void (*renderTriangles)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, const NVGvertex* verts, int nverts);
+	// Optional. Draws a path which is a single shape, filled when strokeWidth is 0 and stroked otherwise.
+	void (*renderShape)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe, float strokeWidth, const NVGshape* shape);
 	void (*renderDelete)(void* uptr);
 };
 typedef struct NVGparams NVGparams;
@@ -32,6 +32,29 @@ enum NVGcreateFlags {
 	NVG_STENCIL_STROKES	= 1<<1,
 	// Flag indicating that additional debug checks are done.
 	NVG_DEBUG 			= 1<<2,
+	// Flag indicating that anti-aliased strokes with round joins and caps are expanded on the GPU
+	// from the path points, using instanced drawing. Needs GL 3.3 or GLES 3, ignored on GL2 and GLES2.
+	NVG_GPU_STROKES		= 1<<3,
+	// Flag indicating that filled curves are evaluated in the fragment shader instead of being
+	// flattened on the CPU. Needs GL 3 or GLES 3, ignored on GL2 and GLES2.
+	NVG_CURVE_FILLS		= 1<<4,
+	// Flag indicating that concave fills of simple polygons are triangulated on the CPU and drawn
+	// in one pass without stencil, like convex fills. Very sharp concave corners get slightly softer.
+	NVG_TRIANGULATE_FILLS	= 1<<5,
+	// Flag indicating that draw calls may be reordered at flush, so that calls with the same state
+	// follow each other. Only calls that do not overlap are moved, the result stays the same.
+	NVG_REORDER_CALLS	= 1<<6,
+	// Flag indicating that strokes thinner than a pixel with a solid color are drawn with a line shader,
+	// which skips the paint and stroke mask evaluation. Not used with stencil strokes. Strokes thinner
+	// than a pixel then also skip their joins and caps.
+	NVG_HAIRLINE_SHADER	= 1<<7,
+	// Flag indicating that glyphs are rasterized once as distance fields, which the text shader
+	// scales to any size and blurs by softening the edge. Glyph corners get slightly rounder.
+	NVG_SDF_TEXT		= 1<<8,
+	// Flag indicating that blurred text is drawn from the distance fields of NVG_SDF_TEXT, blurred by
+	// the text shader, instead of a blurred copy of the glyphs per size and blur. Text without blur
+	// keeps its glyphs. The blur is limited to the spread of the field, FONS_SDF_SPREAD at FONS_SDF_SIZE.
+	NVG_SDF_BLUR		= 1<<9,
 };
 
 #if defined NANOVG_GL2_IMPLEMENTATION
@@ -41,16 +64,25 @@ enum NVGcreateFlags {
 #  define NANOVG_GL3 1
 #  define NANOVG_GL_IMPLEMENTATION 1
 #  define NANOVG_GL_USE_UNIFORMBUFFER 1
+#  define NANOVG_GL_USE_INSTANCING 1
+#  define NANOVG_GL_USE_DERIVATIVES 1
 #elif defined NANOVG_GLES2_IMPLEMENTATION
 #  define NANOVG_GLES2 1
 #  define NANOVG_GL_IMPLEMENTATION 1
 #elif defined NANOVG_GLES3_IMPLEMENTATION
 #  define NANOVG_GLES3 1
 #  define NANOVG_GL_IMPLEMENTATION 1
+#  define NANOVG_GL_USE_INSTANCING 1
+#  define NANOVG_GL_USE_DERIVATIVES 1
 #endif
 
 #define NANOVG_GL_USE_STATE_FILTER (1)
 
+// Max number of consecutive non-overlapping fills that share one stencil pass.
+#define NANOVG_GL_MAX_FILL_BATCH 64
+// Number of pending calls searched for one with the same state, with NVG_REORDER_CALLS.
+#define NANOVG_GL_REORDER_WINDOW 32
+
 // Creates NanoVG contexts for different OpenGL (ES) versions.
 // Flags should be combination of the create flags above.
 
@@ -117,6 +149,7 @@ enum GLNVGuniformLoc {
 	GLNVG_LOC_VIEWSIZE,
 	GLNVG_LOC_TEX,
 	GLNVG_LOC_FRAG,
+	GLNVG_LOC_STROKEEXTENT,
 	GLNVG_MAX_LOCS
 };
 
@@ -165,6 +198,10 @@ enum GLNVGcallType {
 	GLNVG_CONVEXFILL,
 	GLNVG_STROKE,
 	GLNVG_TRIANGLES,
+	GLNVG_STROKEPOINTS,
+	GLNVG_CURVEFILL,
+	GLNVG_SHAPE,
+	GLNVG_HAIRLINE,
 };
 
 struct GLNVGcall {
@@ -175,7 +212,14 @@ struct GLNVGcall {
 	int triangleOffset;
 	int triangleCount;
 	int uniformOffset;
+	float strokeExtent;
 	GLNVGblend blendFunc;
+	int scissor;		// Use the hardware scissor test.
+	float scissorRect[4];	// View units from the top left, converted to pixels at flush.
+	float scissorFringe;	// Width of the shader edge in view units.
+	float bounds[4];	// Bounds of the pixels touched, including the fringes.
+	int batchCount;		// Number of fills stenciled together, set on the first one.
+	int batchOffset;	// Cover quads of the batch as a triangle list.
 };
 typedef struct GLNVGcall GLNVGcall;
 
@@ -184,6 +228,10 @@ struct GLNVGpath {
 	int fillCount;
 	int strokeOffset;
 	int strokeCount;
+	int curveOffset;
+	int curveCount;
+	int convex;
+	GLenum fillMode;
 };
 typedef struct GLNVGpath GLNVGpath;
 
@@ -202,10 +250,13 @@ struct GLNVGfragUniforms {
 		float strokeThr;
 		int texType;
 		int type;
+		float shapeExt[2];
+		float shapeRadius;
+		float shapeStroke;
 	#else
 		// note: after modifying layout or size of uniform array,
 		// don't forget to also update the fragment shader source!
-		#define NANOVG_GL_UNIFORMARRAY_SIZE 11
+		#define NANOVG_GL_UNIFORMARRAY_SIZE 12
 		union {
 			struct {
 				float scissorMat[12]; // matrices are actually 3 vec4s
@@ -221,6 +272,9 @@ struct GLNVGfragUniforms {
 				float strokeThr;
 				float texType;
 				float type;
+				float shapeExt[2];
+				float shapeRadius;
+				float shapeStroke;
 			};
 			float uniformArray[NANOVG_GL_UNIFORMARRAY_SIZE][4];
 		};
@@ -230,8 +284,18 @@ typedef struct GLNVGfragUniforms GLNVGfragUniforms;
 
 struct GLNVGcontext {
 	GLNVGshader shader;
+	GLNVGshader* activeShader;
+#if NANOVG_GL_USE_INSTANCING
+	GLNVGshader strokeShader;
+	GLuint pointBuf;
+#endif
+#if NANOVG_GL_USE_DERIVATIVES
+	GLNVGshader curveShader;
+#endif
+	GLNVGshader lineShader;
 	GLNVGtexture* textures;
 	float view[2];
+	GLint viewport[4];
 	int ntextures;
 	int ctextures;
 	int textureId;
@@ -249,12 +313,17 @@ struct GLNVGcontext {
 	GLNVGcall* calls;
 	int ccalls;
 	int ncalls;
+	GLNVGcall* sortedCalls;
+	int csortedCalls;
 	GLNVGpath* paths;
 	int cpaths;
 	int npaths;
 	struct NVGvertex* verts;
 	int cverts;
 	int nverts;
+	float* points;
+	int cpoints;
+	int npoints;
 	unsigned char* uniforms;
 	int cuniforms;
 	int nuniforms;
@@ -267,11 +336,28 @@ struct GLNVGcontext {
 	GLint stencilFuncRef;
 	GLuint stencilFuncMask;
 	GLNVGblend blendFunc;
+	int scissorTest;
+	GLint scissorRect[4];
 	#endif
 };
 typedef struct GLNVGcontext GLNVGcontext;
 
 static int glnvg__maxi(int a, int b) { return a > b ? a : b; }
+static float glnvg__minf(float a, float b) { return a < b ? a : b; }
+static float glnvg__maxf(float a, float b) { return a > b ? a : b; }
+
+static void glnvg__vertBounds(float* bounds, const NVGvertex* verts, int nverts)
+{
+	int i;
+	bounds[0] = bounds[1] = 1e6f;
+	bounds[2] = bounds[3] = -1e6f;
+	for (i = 0; i < nverts; i++) {
+		bounds[0] = glnvg__minf(bounds[0], verts[i].x);
+		bounds[1] = glnvg__minf(bounds[1], verts[i].y);
+		bounds[2] = glnvg__maxf(bounds[2], verts[i].x);
+		bounds[3] = glnvg__maxf(bounds[3], verts[i].y);
+	}
+}
 
 #ifdef NANOVG_GLES2
 static unsigned int glnvg__nearestPow2(unsigned int num)
@@ -343,6 +429,107 @@ static void glnvg__blendFuncSeparate(GLNVGcontext* gl, const GLNVGblend* blend)
 #endif
 }
 
+static void glnvg__scissorRect(GLNVGcontext* gl, const GLint* rect)
+{
+	if (rect == NULL) {
+#if NANOVG_GL_USE_STATE_FILTER
+		if (gl->scissorTest) {
+			gl->scissorTest = 0;
+			glDisable(GL_SCISSOR_TEST);
+		}
+#else
+		glDisable(GL_SCISSOR_TEST);
+#endif
+		return;
+	}
+
+#if NANOVG_GL_USE_STATE_FILTER
+	if (!gl->scissorTest) {
+		gl->scissorTest = 1;
+		glEnable(GL_SCISSOR_TEST);
+	}
+	if (memcmp(gl->scissorRect, rect, sizeof(gl->scissorRect)) != 0) {
+		memcpy(gl->scissorRect, rect, sizeof(gl->scissorRect));
+		glScissor(rect[0], rect[1], rect[2], rect[3]);
+	}
+#else
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(rect[0], rect[1], rect[2], rect[3]);
+#endif
+}
+
+// Scale from view units to the pixels of the GL viewport.
+static void glnvg__viewScale(GLNVGcontext* gl, float* sx, float* sy)
+{
+	*sx = gl->view[0] > 0.0f ? gl->viewport[2] / gl->view[0] : 1.0f;
+	*sy = gl->view[1] > 0.0f ? gl->viewport[3] / gl->view[1] : 1.0f;
+}
+
+static int glnvg__pixelAligned(float x)
+{
+	return fabsf(x - floorf(x + 0.5f)) < 0.001f;
+}
+
+static void glnvg__scissor(GLNVGcontext* gl, GLNVGcall* call)
+{
+	float sx, sy, x0, y0, x1, y1;
+	GLint rect[4];
+	if (!call->scissor) {
+		glnvg__scissorRect(gl, NULL);
+		return;
+	}
+
+	// When the edges are on pixel boundaries and the shader edge is one pixel wide, the shader covers
+	// whole pixels and the rect is rounded to the nearest pixel. Otherwise the rect is grown by the
+	// half of the shader edge that reaches outside and rounded out.
+	glnvg__viewScale(gl, &sx, &sy);
+	x0 = call->scissorRect[0]*sx;
+	y0 = call->scissorRect[1]*sy;
+	x1 = call->scissorRect[2]*sx;
+	y1 = call->scissorRect[3]*sy;
+	if (glnvg__pixelAligned(x0) && glnvg__pixelAligned(y0) && glnvg__pixelAligned(x1) && glnvg__pixelAligned(y1) &&
+		fabsf(call->scissorFringe*sx - 1.0f) < 0.001f && fabsf(call->scissorFringe*sy - 1.0f) < 0.001f) {
+		x0 = floorf(x0 + 0.5f);
+		y0 = floorf(y0 + 0.5f);
+		x1 = floorf(x1 + 0.5f);
+		y1 = floorf(y1 + 0.5f);
+	} else {
+		x0 = floorf(x0 - call->scissorFringe*0.5f*sx);
+		y0 = floorf(y0 - call->scissorFringe*0.5f*sy);
+		x1 = ceilf(x1 + call->scissorFringe*0.5f*sx);
+		y1 = ceilf(y1 + call->scissorFringe*0.5f*sy);
+	}
+
+	// GL has the origin at the bottom left.
+	rect[0] = gl->viewport[0] + (GLint)x0;
+	rect[1] = gl->viewport[1] + gl->viewport[3] - (GLint)y1;
+	rect[2] = (GLint)(x1 - x0);
+	rect[3] = (GLint)(y1 - y0);
+	glnvg__scissorRect(gl, rect);
+}
+
+// Clears the stencil under the bounds of the call, the stencil is zero everywhere else between calls.
+// Clearing a scissored rect is cheaper than rasterizing and shading the geometry once more.
+static void glnvg__clearStencil(GLNVGcontext* gl, GLNVGcall* call)
+{
+	float sx, sy, x0, y0, x1, y1;
+	GLint rect[4];
+
+	glnvg__viewScale(gl, &sx, &sy);
+	x0 = floorf(glnvg__maxf(call->bounds[0]*sx, -1e7f)) - 1.0f;
+	y0 = floorf(glnvg__maxf(call->bounds[1]*sy, -1e7f)) - 1.0f;
+	x1 = ceilf(glnvg__minf(call->bounds[2]*sx, 1e7f)) + 1.0f;
+	y1 = ceilf(glnvg__minf(call->bounds[3]*sy, 1e7f)) + 1.0f;
+	if (x1 <= x0 || y1 <= y0) return;
+	rect[0] = gl->viewport[0] + (GLint)x0;
+	rect[1] = gl->viewport[1] + gl->viewport[3] - (GLint)y1;
+	rect[2] = (GLint)(x1 - x0);
+	rect[3] = (GLint)(y1 - y0);
+	glnvg__scissorRect(gl, rect);
+	glClear(GL_STENCIL_BUFFER_BIT);
+	glnvg__scissor(gl, call);
+}
+
 static GLNVGtexture* glnvg__allocTexture(GLNVGcontext* gl)
 {
 	GLNVGtexture* tex = NULL;
@@ -492,6 +679,7 @@ static void glnvg__getUniforms(GLNVGshader* shader)
 {
 	shader->loc[GLNVG_LOC_VIEWSIZE] = glGetUniformLocation(shader->prog, "viewSize");
 	shader->loc[GLNVG_LOC_TEX] = glGetUniformLocation(shader->prog, "tex");
+	shader->loc[GLNVG_LOC_STROKEEXTENT] = glGetUniformLocation(shader->prog, "strokeExtent");
 
 #if NANOVG_GL_USE_UNIFORMBUFFER
 	shader->loc[GLNVG_LOC_FRAG] = glGetUniformBlockIndex(shader->prog, "frag");
@@ -524,7 +712,7 @@ static int glnvg__renderCreate(void* uptr)
 #if NANOVG_GL_USE_UNIFORMBUFFER
 	"#define USE_UNIFORMBUFFER 1\n"
 #else
-	"#define UNIFORMARRAY_SIZE 11\n"
+	"#define UNIFORMARRAY_SIZE 12\n"
 #endif
 	"\n";
 
@@ -548,6 +736,30 @@ static int glnvg__renderCreate(void* uptr)
 		"	gl_Position = vec4(2.0*vertex.x/viewSize.x - 1.0, 1.0 - 2.0*vertex.y/viewSize.y, 0, 1);\n"
 		"}\n";
 
+#if NANOVG_GL_USE_INSTANCING
+	// Expands one instanced quad per segment, vertex and tcoord hold the segment end points.
+	static const char* strokeVertShader =
+		"uniform vec2 viewSize;\n"
+		"uniform float strokeExtent;\n"
+		"in vec2 vertex;\n"
+		"in vec2 tcoord;\n"
+		"out vec2 ftcoord;\n"
+		"out vec2 fpos;\n"
+		"flat out float flen;\n"
+		"void main(void) {\n"
+		"	vec2 d = tcoord - vertex;\n"
+		"	float len = length(d);\n"
+		"	vec2 dir = len > 0.0 ? d / len : vec2(1.0, 0.0);\n"
+		"	float along = (gl_VertexID & 1) != 0 ? len + strokeExtent : -strokeExtent;\n"
+		"	float side = (gl_VertexID & 2) != 0 ? strokeExtent : -strokeExtent;\n"
+		"	vec2 pos = vertex + dir * along + vec2(-dir.y, dir.x) * side;\n"
+		"	ftcoord = vec2(along, side) / strokeExtent;\n"
+		"	flen = len / strokeExtent;\n"
+		"	fpos = pos;\n"
+		"	gl_Position = vec4(2.0*pos.x/viewSize.x - 1.0, 1.0 - 2.0*pos.y/viewSize.y, 0, 1);\n"
+		"}\n";
+#endif
+
 	static const char* fillFragShader =
 		"#ifdef GL_ES\n"
 		"#if defined(GL_FRAGMENT_PRECISION_HIGH) || defined(NANOVG_GL3)\n"
@@ -572,6 +784,9 @@ static int glnvg__renderCreate(void* uptr)
 		"		float strokeThr;\n"
 		"		int texType;\n"
 		"		int type;\n"
+		"		vec2 shapeExt;\n"
+		"		float shapeRadius;\n"
+		"		float shapeStroke;\n"
 		"	};\n"
 		"#else\n" // NANOVG_GL3 && !USE_UNIFORMBUFFER
 		"	uniform vec4 frag[UNIFORMARRAY_SIZE];\n"
@@ -579,6 +794,9 @@ static int glnvg__renderCreate(void* uptr)
 		"	uniform sampler2D tex;\n"
 		"	in vec2 ftcoord;\n"
 		"	in vec2 fpos;\n"
+		"#ifdef STROKE_POINTS\n"
+		"	flat in float flen;\n"
+		"#endif\n"
 		"	out vec4 outColor;\n"
 		"#else\n" // !NANOVG_GL3
 		"	uniform vec4 frag[UNIFORMARRAY_SIZE];\n"
@@ -600,6 +818,9 @@ static int glnvg__renderCreate(void* uptr)
 		"	#define strokeThr frag[10].y\n"
 		"	#define texType int(frag[10].z)\n"
 		"	#define type int(frag[10].w)\n"
+		"	#define shapeExt frag[11].xy\n"
+		"	#define shapeRadius frag[11].z\n"
+		"	#define shapeStroke frag[11].w\n"
 		"#endif\n"
 		"\n"
 		"float sdroundrect(vec2 pt, vec2 ext, float rad) {\n"
@@ -608,13 +829,48 @@ static int glnvg__renderCreate(void* uptr)
 		"	return min(max(d.x,d.y),0.0) + length(max(d,0.0)) - rad;\n"
 		"}\n"
 		"\n"
+		"// Shapes - distance in fringe widths, ellipses are marked with negative radius.\n"
+		"float shapeMask(vec2 pt) {\n"
+		"	float d;\n"
+		"	if (shapeRadius < 0.0) {\n"
+		"		vec2 q = pt / shapeExt;\n"
+		"		d = (dot(q,q) - 1.0) / max(length(2.0*q / shapeExt), 1e-6);\n"
+		"	} else if (shapeRadius == 0.0) {\n"
+		"		vec2 e = abs(pt) - shapeExt;\n"
+		"		d = max(e.x, e.y);\n"
+		"	} else {\n"
+		"		d = sdroundrect(pt, shapeExt, shapeRadius);\n"
+		"	}\n"
+		"	if (shapeStroke > 0.0) d = abs(d) - shapeStroke*0.5;\n"
+		"#ifdef EDGE_AA\n"
+		"	return clamp(0.5 - d, 0.0, 1.0);\n"
+		"#else\n"
+		"	return d < 0.0 ? 1.0 : 0.0;\n"
+		"#endif\n"
+		"}\n"
+		"\n"
 		"// Scissoring\n"
 		"float scissorMask(vec2 p) {\n"
 		"	vec2 sc = (abs((scissorMat * vec3(p,1.0)).xy) - scissorExt);\n"
 		"	sc = vec2(0.5,0.5) - sc * scissorScale;\n"
 		"	return clamp(sc.x,0.0,1.0) * clamp(sc.y,0.0,1.0);\n"
 		"}\n"
-		"#ifdef EDGE_AA\n"
+		"#if defined(CURVE_FILL)\n"
+		"// Curve - distance to the curve u*u - v = 0 in pixels, negative strokeMult for the inside.\n"
+		"float strokeMask() {\n"
+		"	float f = ftcoord.x*ftcoord.x - ftcoord.y;\n"
+		"	vec2 g = 2.0*ftcoord.x*vec2(dFdx(ftcoord.x), dFdy(ftcoord.x)) - vec2(dFdx(ftcoord.y), dFdy(ftcoord.y));\n"
+		"	float d = abs(f) / max(length(g), 1e-6);\n"
+		"	if (ftcoord.x < 0.0 || ftcoord.x > 1.0) d = 1e6;\n"
+		"	return clamp(0.5 - d*strokeMult, 0.0, 1.0);\n"
+		"}\n"
+		"#elif defined(STROKE_POINTS)\n"
+		"// Stroke - distance to the segment in stroke extents, where the slope is 1px.\n"
+		"float strokeMask() {\n"
+		"	vec2 d = vec2(ftcoord.x - clamp(ftcoord.x, 0.0, flen), ftcoord.y);\n"
+		"	return clamp((1.0 - length(d)) * strokeMult, 0.0, 1.0);\n"
+		"}\n"
+		"#elif defined(EDGE_AA)\n"
 		"// Stroke - from [0..1] to clipped pyramid, where the slope is 1px.\n"
 		"float strokeMask() {\n"
 		"	return min(1.0, (1.0-abs(ftcoord.x*2.0-1.0))*strokeMult) * min(1.0, ftcoord.y);\n"
@@ -624,11 +880,19 @@ static int glnvg__renderCreate(void* uptr)
 		"void main(void) {\n"
 		"   vec4 result;\n"
 		"	float scissor = scissorMask(fpos);\n"
+		"#ifdef HAIRLINE\n"
+		"	// Hairline - solid color with the [0..1] pyramid across the line.\n"
+		"	result = innerCol * (1.0-abs(ftcoord.x*2.0-1.0)) * scissor;\n"
+		"#else\n"
 		"#ifdef EDGE_AA\n"
-		"	float strokeAlpha = strokeMask();\n"
+		"	float strokeAlpha = shapeExt.x > 0.0 ? shapeMask(ftcoord) : strokeMask();\n"
 		"	if (strokeAlpha < strokeThr) discard;\n"
 		"#else\n"
-		"	float strokeAlpha = 1.0;\n"
+		"	float strokeAlpha = shapeExt.x > 0.0 ? shapeMask(ftcoord) : 1.0;\n"
+		"#endif\n"
+		"#ifdef CURVE_FILL\n"
+		"	// Stencil only the region between the chord and the curve.\n"
+		"	if (type == 2 && ftcoord.x*ftcoord.x > ftcoord.y) discard;\n"
 		"#endif\n"
 		"	if (type == 0) {			// Gradient\n"
 		"		// Calculate gradient color using box gradient\n"
@@ -648,6 +912,7 @@ static int glnvg__renderCreate(void* uptr)
 		"#endif\n"
 		"		if (texType == 1) color = vec4(color.xyz*color.w,color.w);"
 		"		if (texType == 2) color = vec4(color.x);"
+		"		if (texType == 3) color = vec4(clamp((color.x - radius) * feather + 0.5, 0.0, 1.0));\n"
 		"		// Apply color tint and alpha.\n"
 		"		color *= innerCol;\n"
 		"		// Combine alpha\n"
@@ -663,9 +928,11 @@ static int glnvg__renderCreate(void* uptr)
 		"#endif\n"
 		"		if (texType == 1) color = vec4(color.xyz*color.w,color.w);"
 		"		if (texType == 2) color = vec4(color.x);"
+		"		if (texType == 3) color = vec4(clamp((color.x - radius) * feather + 0.5, 0.0, 1.0));\n"
 		"		color *= scissor;\n"
 		"		result = color * innerCol;\n"
 		"	}\n"
+		"#endif\n"
 		"#ifdef NANOVG_GL3\n"
 		"	outColor = result;\n"
 		"#else\n"
@@ -685,6 +952,28 @@ static int glnvg__renderCreate(void* uptr)
 
 	glnvg__checkError(gl, "uniform locations");
 	glnvg__getUniforms(&gl->shader);
+	gl->activeShader = &gl->shader;
+
+#if NANOVG_GL_USE_INSTANCING
+	if (gl->flags & NVG_GPU_STROKES) {
+		if (glnvg__createShader(&gl->strokeShader, "stroke", shaderHeader, "#define EDGE_AA 1\n#define STROKE_POINTS 1\n", strokeVertShader, fillFragShader) == 0)
+			return 0;
+		glnvg__getUniforms(&gl->strokeShader);
+		glGenBuffers(1, &gl->pointBuf);
+	}
+#endif
+#if NANOVG_GL_USE_DERIVATIVES
+	if (gl->flags & NVG_CURVE_FILLS) {
+		if (glnvg__createShader(&gl->curveShader, "curve", shaderHeader, "#define EDGE_AA 1\n#define CURVE_FILL 1\n", fillVertShader, fillFragShader) == 0)
+			return 0;
+		glnvg__getUniforms(&gl->curveShader);
+	}
+#endif
+	if (gl->flags & NVG_HAIRLINE_SHADER) {
+		if (glnvg__createShader(&gl->lineShader, "line", shaderHeader, "#define HAIRLINE 1\n", fillVertShader, fillFragShader) == 0)
+			return 0;
+		glnvg__getUniforms(&gl->lineShader);
+	}
 
 	// Create dynamic vertex array
 #if defined NANOVG_GL3
@@ -695,6 +984,16 @@ static int glnvg__renderCreate(void* uptr)
 #if NANOVG_GL_USE_UNIFORMBUFFER
 	// Create UBOs
 	glUniformBlockBinding(gl->shader.prog, gl->shader.loc[GLNVG_LOC_FRAG], GLNVG_FRAG_BINDING);
+#if NANOVG_GL_USE_INSTANCING
+	if (gl->flags & NVG_GPU_STROKES)
+		glUniformBlockBinding(gl->strokeShader.prog, gl->strokeShader.loc[GLNVG_LOC_FRAG], GLNVG_FRAG_BINDING);
+#endif
+#if NANOVG_GL_USE_DERIVATIVES
+	if (gl->flags & NVG_CURVE_FILLS)
+		glUniformBlockBinding(gl->curveShader.prog, gl->curveShader.loc[GLNVG_LOC_FRAG], GLNVG_FRAG_BINDING);
+#endif
+	if (gl->flags & NVG_HAIRLINE_SHADER)
+		glUniformBlockBinding(gl->lineShader.prog, gl->lineShader.loc[GLNVG_LOC_FRAG], GLNVG_FRAG_BINDING);
 	glGenBuffers(1, &gl->fragBuf);
 	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
 #endif
@@ -949,13 +1248,16 @@ static int glnvg__convertPaint(GLNVGcontext* gl, GLNVGfragUniforms* frag, NVGpai
 		if (tex->type == NVG_TEXTURE_RGBA)
 			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
 		else
-			frag->texType = 2;
+			frag->texType = (tex->flags & NVG_IMAGE_SDF) ? 3 : 2;
 		#else
 		if (tex->type == NVG_TEXTURE_RGBA)
 			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0.0f : 1.0f;
 		else
-			frag->texType = 2.0f;
+			frag->texType = (tex->flags & NVG_IMAGE_SDF) ? 3.0f : 2.0f;
 		#endif
+		// Distance field edge and scale.
+		frag->radius = paint->radius;
+		frag->feather = paint->feather;
 //		printf("frag->texType = %d\n", frag->texType);
 	} else {
 		frag->type = NSVG_SHADER_FILLGRAD;
@@ -970,6 +1272,7 @@ static int glnvg__convertPaint(GLNVGcontext* gl, GLNVGfragUniforms* frag, NVGpai
 }
 
 static GLNVGfragUniforms* nvg__fragUniformPtr(GLNVGcontext* gl, int i);
+static int glnvg__allocVerts(GLNVGcontext* gl, int n);
 
 static void glnvg__setUniforms(GLNVGcontext* gl, int uniformOffset, int image)
 {
@@ -977,7 +1280,7 @@ static void glnvg__setUniforms(GLNVGcontext* gl, int uniformOffset, int image)
 	glBindBufferRange(GL_UNIFORM_BUFFER, GLNVG_FRAG_BINDING, gl->fragBuf, uniformOffset, sizeof(GLNVGfragUniforms));
 #else
 	GLNVGfragUniforms* frag = nvg__fragUniformPtr(gl, uniformOffset);
-	glUniform4fv(gl->shader.loc[GLNVG_LOC_FRAG], NANOVG_GL_UNIFORMARRAY_SIZE, &(frag->uniformArray[0][0]));
+	glUniform4fv(gl->activeShader->loc[GLNVG_LOC_FRAG], NANOVG_GL_UNIFORMARRAY_SIZE, &(frag->uniformArray[0][0]));
 #endif
 
 	if (image != 0) {
@@ -991,17 +1294,87 @@ static void glnvg__setUniforms(GLNVGcontext* gl, int uniformOffset, int image)
 
 static void glnvg__renderViewport(void* uptr, float width, float height, float devicePixelRatio)
 {
-	NVG_NOTUSED(devicePixelRatio);
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
 	gl->view[0] = width;
 	gl->view[1] = height;
+	NVG_NOTUSED(devicePixelRatio);
 }
 
-static void glnvg__fill(GLNVGcontext* gl, GLNVGcall* call)
+// Axis aligned scissors also use the hardware scissor test, so that the fragments outside are not shaded.
+// The shader scissor is kept, it anti-aliases the edges. The rect is converted to pixels at flush, when
+// the scale of the viewport is known.
+static void glnvg__setupScissor(GLNVGcall* call, NVGscissor* scissor, float fringe)
+{
+	const float* t = scissor->xform;
+	float hx, hy;
+	int i;
+
+	if (scissor->extent[0] < -0.5f || scissor->extent[1] < -0.5f)
+		return;
+	if (!((t[1] == 0.0f && t[2] == 0.0f) || (t[0] == 0.0f && t[3] == 0.0f)))
+		return;
+
+	hx = fabsf(t[0])*scissor->extent[0] + fabsf(t[2])*scissor->extent[1];
+	hy = fabsf(t[1])*scissor->extent[0] + fabsf(t[3])*scissor->extent[1];
+	call->scissorRect[0] = t[4] - hx;
+	call->scissorRect[1] = t[5] - hy;
+	call->scissorRect[2] = t[4] + hx;
+	call->scissorRect[3] = t[5] + hy;
+	for (i = 0; i < 4; i++)
+		call->scissorRect[i] = glnvg__minf(glnvg__maxf(call->scissorRect[i], -1e7f), 1e7f);
+	call->scissorFringe = fringe;
+	call->scissor = 1;
+}
+
+static void glnvg__useShader(GLNVGcontext* gl, GLNVGshader* shader)
+{
+	glUseProgram(shader->prog);
+	gl->activeShader = shader;
+}
+
+// Draws the paths of a fill that do not overlap the rest directly.
+static void glnvg__fillConvexPaths(GLNVGcontext* gl, GLNVGcall* call)
+{
+	GLNVGpath* paths = &gl->paths[call->pathOffset];
+	int i, npaths = call->pathCount, nconvex = 0;
+
+	for (i = 0; i < npaths; i++) {
+		if (!paths[i].convex) continue;
+		if (nconvex++ == 0) {
+			glnvg__setUniforms(gl, call->uniformOffset + gl->fragSize, call->image);
+			glnvg__checkError(gl, "fill convex");
+		}
+		glDrawArrays(paths[i].fillMode, paths[i].fillOffset, paths[i].fillCount);
+		if (paths[i].strokeCount > 0)
+			glDrawArrays(GL_TRIANGLE_STRIP, paths[i].strokeOffset, paths[i].strokeCount);
+	}
+}
+
+static void glnvg__fillStencil(GLNVGcontext* gl, GLNVGcall* call)
 {
 	GLNVGpath* paths = &gl->paths[call->pathOffset];
 	int i, npaths = call->pathCount;
 
+	for (i = 0; i < npaths; i++)
+		if (!paths[i].convex)
+			glDrawArrays(GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
+}
+
+static void glnvg__fillFringes(GLNVGcontext* gl, GLNVGcall* call)
+{
+	GLNVGpath* paths = &gl->paths[call->pathOffset];
+	int i, npaths = call->pathCount;
+
+	for (i = 0; i < npaths; i++)
+		if (!paths[i].convex)
+			glDrawArrays(GL_TRIANGLE_STRIP, paths[i].strokeOffset, paths[i].strokeCount);
+}
+
+static void glnvg__fill(GLNVGcontext* gl, GLNVGcall* call)
+{
+	// Draw separate convex paths directly, they do not overlap the rest.
+	glnvg__fillConvexPaths(gl, call);
+
 	// Draw shapes
 	glEnable(GL_STENCIL_TEST);
 	glnvg__stencilMask(gl, 0xff);
@@ -1015,8 +1388,7 @@ static void glnvg__fill(GLNVGcontext* gl, GLNVGcall* call)
 	glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
 	glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
 	glDisable(GL_CULL_FACE);
-	for (i = 0; i < npaths; i++)
-		glDrawArrays(GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
+	glnvg__fillStencil(gl, call);
 	glEnable(GL_CULL_FACE);
 
 	// Draw anti-aliased pixels
@@ -1029,8 +1401,7 @@ static void glnvg__fill(GLNVGcontext* gl, GLNVGcall* call)
 		glnvg__stencilFunc(gl, GL_EQUAL, 0x00, 0xff);
 		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
 		// Draw fringes
-		for (i = 0; i < npaths; i++)
-			glDrawArrays(GL_TRIANGLE_STRIP, paths[i].strokeOffset, paths[i].strokeCount);
+		glnvg__fillFringes(gl, call);
 	}
 
 	// Draw fill
@@ -1041,6 +1412,228 @@ static void glnvg__fill(GLNVGcontext* gl, GLNVGcall* call)
 	glDisable(GL_STENCIL_TEST);
 }
 
+static int glnvg__samePaint(GLNVGcontext* gl, GLNVGcall* a, GLNVGcall* b)
+{
+	return a->image == b->image &&
+		memcmp(nvg__fragUniformPtr(gl, a->uniformOffset + gl->fragSize),
+			   nvg__fragUniformPtr(gl, b->uniformOffset + gl->fragSize), sizeof(GLNVGfragUniforms)) == 0;
+}
+
+// Like glnvg__fill() for a batch of fills that do not overlap each other. All of them are
+// stenciled in one pass, and runs of fills with the same paint are covered with one draw.
+static void glnvg__fillBatch(GLNVGcontext* gl, GLNVGcall* calls)
+{
+	int i, j, k, n = calls->batchCount;
+
+	for (i = 0; i < n; i++)
+		glnvg__fillConvexPaths(gl, &calls[i]);
+
+	glEnable(GL_STENCIL_TEST);
+	glnvg__stencilMask(gl, 0xff);
+	glnvg__stencilFunc(gl, GL_ALWAYS, 0, 0xff);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	// The stencil uniforms are the same for all fills.
+	glnvg__setUniforms(gl, calls->uniformOffset, 0);
+	glnvg__checkError(gl, "fill batch simple");
+
+	glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
+	glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
+	glDisable(GL_CULL_FACE);
+	for (i = 0; i < n; i++)
+		glnvg__fillStencil(gl, &calls[i]);
+	glEnable(GL_CULL_FACE);
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	for (i = 0; i < n; i = j) {
+		for (j = i+1; j < n && glnvg__samePaint(gl, &calls[i], &calls[j]); j++);
+
+		glnvg__setUniforms(gl, calls[i].uniformOffset + gl->fragSize, calls[i].image);
+		glnvg__checkError(gl, "fill batch fill");
+
+		if (gl->flags & NVG_ANTIALIAS) {
+			glnvg__stencilFunc(gl, GL_EQUAL, 0x00, 0xff);
+			glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+			for (k = i; k < j; k++)
+				glnvg__fillFringes(gl, &calls[k]);
+		}
+
+		glnvg__stencilFunc(gl, GL_NOTEQUAL, 0x0, 0xff);
+		glStencilOp(GL_ZERO, GL_ZERO, GL_ZERO);
+		glDrawArrays(GL_TRIANGLES, calls->batchOffset + i*6, (j-i)*6);
+	}
+
+	glDisable(GL_STENCIL_TEST);
+}
+
+static int glnvg__callsOverlap(const GLNVGcall* a, const GLNVGcall* b)
+{
+	return a->bounds[2] >= b->bounds[0] && a->bounds[0] <= b->bounds[2] &&
+		   a->bounds[3] >= b->bounds[1] && a->bounds[1] <= b->bounds[3];
+}
+
+static int glnvg__sameScissor(const GLNVGcall* a, const GLNVGcall* b)
+{
+	return a->scissor == b->scissor && memcmp(a->scissorRect, b->scissorRect, sizeof(a->scissorRect)) == 0 &&
+		   a->scissorFringe == b->scissorFringe;
+}
+
+static int glnvg__canBatchFill(GLNVGcall* calls, int n, GLNVGcall* call)
+{
+	int i;
+	if (call->type != GLNVG_FILL || memcmp(&call->blendFunc, &calls->blendFunc, sizeof(GLNVGblend)) != 0)
+		return 0;
+	if (!glnvg__sameScissor(call, calls))
+		return 0;
+	for (i = 0; i < n; i++)
+		if (glnvg__callsOverlap(&calls[i], call))
+			return 0;
+	return 1;
+}
+
+// Texture changes are the most expensive, then shader and the state that differs between call types.
+static int glnvg__stateMatch(const GLNVGcall* a, const GLNVGcall* b)
+{
+	return (a->image == b->image) * 8 +
+		   (a->type == b->type) * 4 +
+		   (memcmp(&a->blendFunc, &b->blendFunc, sizeof(GLNVGblend)) == 0) * 2 +
+		   glnvg__sameScissor(a, b);
+}
+
+// Orders the calls so that calls with the same state follow each other. Each step takes, from a window
+// of the first pending calls, the one best matching the previous call that overlaps none of the pending
+// calls before it. The first pending call is always ready, so a call never passes one it overlaps.
+static void glnvg__reorderCalls(GLNVGcontext* gl)
+{
+	int window[NANOVG_GL_REORDER_WINDOW];
+	int i, j, k, nwindow = 0, next = 0, best, match, bestMatch;
+
+	if (gl->ncalls > gl->csortedCalls) {
+		GLNVGcall* sorted;
+		int csorted = gl->ncalls + gl->csortedCalls/2; // 1.5x Overallocate
+		sorted = (GLNVGcall*)realloc(gl->sortedCalls, sizeof(GLNVGcall) * csorted);
+		if (sorted == NULL) return;
+		gl->sortedCalls = sorted;
+		gl->csortedCalls = csorted;
+	}
+
+	for (i = 0; i < gl->ncalls; i++) {
+		while (nwindow < NANOVG_GL_REORDER_WINDOW && next < gl->ncalls)
+			window[nwindow++] = next++;
+
+		best = 0;
+		if (i > 0) {
+			bestMatch = glnvg__stateMatch(&gl->calls[window[0]], &gl->sortedCalls[i-1]);
+			for (j = 1; j < nwindow && bestMatch < 15; j++) {
+				GLNVGcall* call = &gl->calls[window[j]];
+				match = glnvg__stateMatch(call, &gl->sortedCalls[i-1]);
+				if (match <= bestMatch) continue;
+				for (k = 0; k < j; k++)
+					if (glnvg__callsOverlap(&gl->calls[window[k]], call)) break;
+				if (k == j) {
+					best = j;
+					bestMatch = match;
+				}
+			}
+		}
+
+		gl->sortedCalls[i] = gl->calls[window[best]];
+		nwindow--;
+		memmove(&window[best], &window[best+1], sizeof(int) * (nwindow - best));
+	}
+
+	memcpy(gl->calls, gl->sortedCalls, sizeof(GLNVGcall) * gl->ncalls);
+}
+
+// Groups consecutive stencil fills that share blending and scissor and do not overlap, and adds
+// the cover quads of each group as one triangle list. Called before the vertices are uploaded.
+static void glnvg__batchFills(GLNVGcontext* gl)
+{
+	int i, j, n, offset;
+
+	for (i = 0; i < gl->ncalls; i += n) {
+		GLNVGcall* calls = &gl->calls[i];
+		n = 1;
+		if (calls->type != GLNVG_FILL) continue;
+		while (i+n < gl->ncalls && n < NANOVG_GL_MAX_FILL_BATCH && glnvg__canBatchFill(calls, n, &calls[n]))
+			n++;
+		if (n < 2) continue;
+
+		offset = glnvg__allocVerts(gl, n*6);
+		if (offset == -1) return;
+		for (j = 0; j < n; j++) {
+			NVGvertex* quad = &gl->verts[calls[j].triangleOffset];
+			NVGvertex* dst = &gl->verts[offset + j*6];
+			dst[0] = quad[0]; dst[1] = quad[1]; dst[2] = quad[2];
+			dst[3] = quad[2]; dst[4] = quad[1]; dst[5] = quad[3];
+		}
+		calls->batchCount = n;
+		calls->batchOffset = offset;
+	}
+}
+
+#if NANOVG_GL_USE_DERIVATIVES
+static void glnvg__curveFill(GLNVGcontext* gl, GLNVGcall* call)
+{
+	GLNVGpath* paths = &gl->paths[call->pathOffset];
+	int i, npaths = call->pathCount;
+
+	glnvg__useShader(gl, &gl->curveShader);
+
+	// Draw shapes, the curve triangles add the regions between the chords and the curves.
+	glEnable(GL_STENCIL_TEST);
+	glnvg__stencilMask(gl, 0xff);
+	glnvg__stencilFunc(gl, GL_ALWAYS, 0, 0xff);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	glnvg__setUniforms(gl, call->uniformOffset, 0);
+	glnvg__checkError(gl, "curve fill simple");
+
+	glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
+	glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
+	glDisable(GL_CULL_FACE);
+	for (i = 0; i < npaths; i++) {
+		glDrawArrays(GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
+		glDrawArrays(GL_TRIANGLES, paths[i].curveOffset, paths[i].curveCount);
+	}
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	// Draw anti-aliased pixels, the fringe triangles can face either way and overlap.
+	// The winding is in the low 7 bits, the high bit marks the pixels drawn outside, so that
+	// each pixel is blended once.
+	if (gl->flags & NVG_ANTIALIAS) {
+		// Outside of the shape.
+		glnvg__setUniforms(gl, call->uniformOffset + gl->fragSize, call->image);
+		glnvg__checkError(gl, "curve fill fringe");
+		glnvg__stencilMask(gl, 0x80);
+		glnvg__stencilFunc(gl, GL_EQUAL, 0x00, 0xff);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_INVERT);
+		for (i = 0; i < npaths; i++)
+			glDrawArrays(GL_TRIANGLES, paths[i].strokeOffset, paths[i].strokeCount);
+		glnvg__stencilMask(gl, 0xff);
+
+		// Inside of the shape, the drawn pixels are removed from the fill.
+		glnvg__setUniforms(gl, call->uniformOffset + gl->fragSize*2, call->image);
+		glnvg__stencilFunc(gl, GL_NOTEQUAL, 0x00, 0x7f);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+		for (i = 0; i < npaths; i++)
+			glDrawArrays(GL_TRIANGLES, paths[i].strokeOffset, paths[i].strokeCount);
+	}
+	glEnable(GL_CULL_FACE);
+
+	// Draw fill, the cover quad spans the fringes and also clears the marks.
+	glnvg__useShader(gl, &gl->shader);
+	glnvg__setUniforms(gl, call->uniformOffset + gl->fragSize, call->image);
+	glnvg__stencilFunc(gl, GL_NOTEQUAL, 0x0, 0x7f);
+	glStencilOp(GL_ZERO, GL_ZERO, GL_ZERO);
+	glDrawArrays(GL_TRIANGLE_STRIP, call->triangleOffset, call->triangleCount);
+
+	glDisable(GL_STENCIL_TEST);
+}
+#endif
+
 static void glnvg__convexFill(GLNVGcontext* gl, GLNVGcall* call)
 {
 	GLNVGpath* paths = &gl->paths[call->pathOffset];
@@ -1050,7 +1643,7 @@ static void glnvg__convexFill(GLNVGcontext* gl, GLNVGcall* call)
 	glnvg__checkError(gl, "convex fill");
 
 	for (i = 0; i < npaths; i++) {
-		glDrawArrays(GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
+		glDrawArrays(paths[i].fillMode, paths[i].fillOffset, paths[i].fillCount);
 		// Draw fringes
 		if (paths[i].strokeCount > 0) {
 			glDrawArrays(GL_TRIANGLE_STRIP, paths[i].strokeOffset, paths[i].strokeCount);
@@ -1084,13 +1677,8 @@ static void glnvg__stroke(GLNVGcontext* gl, GLNVGcall* call)
 			glDrawArrays(GL_TRIANGLE_STRIP, paths[i].strokeOffset, paths[i].strokeCount);
 
 		// Clear stencil buffer.
-		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-		glnvg__stencilFunc(gl, GL_ALWAYS, 0x0, 0xff);
-		glStencilOp(GL_ZERO, GL_ZERO, GL_ZERO);
+		glnvg__clearStencil(gl, call);
 		glnvg__checkError(gl, "stroke fill 1");
-		for (i = 0; i < npaths; i++)
-			glDrawArrays(GL_TRIANGLE_STRIP, paths[i].strokeOffset, paths[i].strokeCount);
-		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
 		glDisable(GL_STENCIL_TEST);
 
@@ -1105,6 +1693,71 @@ static void glnvg__stroke(GLNVGcontext* gl, GLNVGcall* call)
 	}
 }
 
+#if NANOVG_GL_USE_INSTANCING
+static void glnvg__drawStrokePoints(GLNVGcontext* gl, GLNVGcall* call)
+{
+	GLNVGpath* paths = &gl->paths[call->pathOffset];
+	int npaths = call->pathCount, i;
+	for (i = 0; i < npaths; i++) {
+		size_t offset = (size_t)paths[i].strokeOffset * 2*sizeof(float);
+		if (paths[i].strokeCount == 0) continue;
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), (const GLvoid*)offset);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), (const GLvoid*)(offset + 2*sizeof(float)));
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, paths[i].strokeCount);
+	}
+}
+
+static void glnvg__strokePoints(GLNVGcontext* gl, GLNVGcall* call)
+{
+	glnvg__useShader(gl, &gl->strokeShader);
+	glUniform1f(gl->strokeShader.loc[GLNVG_LOC_STROKEEXTENT], call->strokeExtent);
+	glBindBuffer(GL_ARRAY_BUFFER, gl->pointBuf);
+	glVertexAttribDivisor(0, 1);
+	glVertexAttribDivisor(1, 1);
+	glDisable(GL_CULL_FACE);
+
+	// The segment quads overlap at the joins, use the stencil stroke passes to avoid double blending.
+	glEnable(GL_STENCIL_TEST);
+	glnvg__stencilMask(gl, 0xff);
+
+	// Fill the stroke base without overlap
+	glnvg__stencilFunc(gl, GL_EQUAL, 0x0, 0xff);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+	glnvg__setUniforms(gl, call->uniformOffset + gl->fragSize, call->image);
+	glnvg__checkError(gl, "stroke points 0");
+	glnvg__drawStrokePoints(gl, call);
+
+	// Draw anti-aliased pixels.
+	glnvg__setUniforms(gl, call->uniformOffset, call->image);
+	glnvg__stencilFunc(gl, GL_EQUAL, 0x00, 0xff);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	glnvg__drawStrokePoints(gl, call);
+
+	// Clear stencil buffer.
+	glnvg__clearStencil(gl, call);
+	glnvg__checkError(gl, "stroke points 1");
+
+	glDisable(GL_STENCIL_TEST);
+
+	// Restore the vertex layout of the other calls.
+	glEnable(GL_CULL_FACE);
+	glVertexAttribDivisor(0, 0);
+	glVertexAttribDivisor(1, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, gl->vertBuf);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(NVGvertex), (const GLvoid*)(size_t)0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(NVGvertex), (const GLvoid*)(0 + 2*sizeof(float)));
+	glnvg__useShader(gl, &gl->shader);
+}
+#endif
+
+static void glnvg__shape(GLNVGcontext* gl, GLNVGcall* call)
+{
+	glnvg__setUniforms(gl, call->uniformOffset, call->image);
+	glnvg__checkError(gl, "shape fill");
+
+	glDrawArrays(GL_TRIANGLE_STRIP, call->triangleOffset, call->triangleCount);
+}
+
 static void glnvg__triangles(GLNVGcontext* gl, GLNVGcall* call)
 {
 	glnvg__setUniforms(gl, call->uniformOffset, call->image);
@@ -1113,9 +1766,23 @@ static void glnvg__triangles(GLNVGcontext* gl, GLNVGcall* call)
 	glDrawArrays(GL_TRIANGLES, call->triangleOffset, call->triangleCount);
 }
 
+static void glnvg__hairlines(GLNVGcontext* gl, GLNVGcall* call)
+{
+	GLNVGpath* paths = &gl->paths[call->pathOffset];
+	int npaths = call->pathCount, i;
+
+	glnvg__useShader(gl, &gl->lineShader);
+	glnvg__setUniforms(gl, call->uniformOffset, call->image);
+	glnvg__checkError(gl, "hairlines");
+	for (i = 0; i < npaths; i++)
+		glDrawArrays(GL_TRIANGLE_STRIP, paths[i].strokeOffset, paths[i].strokeCount);
+	glnvg__useShader(gl, &gl->shader);
+}
+
 static void glnvg__renderCancel(void* uptr) {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
 	gl->nverts = 0;
+	gl->npoints = 0;
 	gl->npaths = 0;
 	gl->ncalls = 0;
 	gl->nuniforms = 0;
@@ -1172,8 +1839,13 @@ static void glnvg__renderFlush(void* uptr)
 
 	if (gl->ncalls > 0) {
 
+		if (gl->flags & NVG_REORDER_CALLS)
+			glnvg__reorderCalls(gl);
+		glnvg__batchFills(gl);
+
 		// Setup require GL state.
 		glUseProgram(gl->shader.prog);
+		gl->activeShader = &gl->shader;
 
 		glEnable(GL_CULL_FACE);
 		glCullFace(GL_BACK);
@@ -1185,6 +1857,7 @@ static void glnvg__renderFlush(void* uptr)
 		glStencilMask(0xffffffff);
 		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
 		glStencilFunc(GL_ALWAYS, 0, 0xffffffff);
+		glClearStencil(0);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, 0);
 		#if NANOVG_GL_USE_STATE_FILTER
@@ -1197,7 +1870,10 @@ static void glnvg__renderFlush(void* uptr)
 		gl->blendFunc.srcAlpha = GL_INVALID_ENUM;
 		gl->blendFunc.dstRGB = GL_INVALID_ENUM;
 		gl->blendFunc.dstAlpha = GL_INVALID_ENUM;
+		gl->scissorTest = 0;
+		gl->scissorRect[2] = -1;
 		#endif
+		glGetIntegerv(GL_VIEWPORT, gl->viewport);
 
 #if NANOVG_GL_USE_UNIFORMBUFFER
 		// Upload ubo for frag shaders
@@ -1209,6 +1885,30 @@ static void glnvg__renderFlush(void* uptr)
 #if defined NANOVG_GL3
 		glBindVertexArray(gl->vertArr);
 #endif
+#if NANOVG_GL_USE_INSTANCING
+		if (gl->npoints > 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, gl->pointBuf);
+			glBufferData(GL_ARRAY_BUFFER, gl->npoints * 2*sizeof(float), gl->points, GL_STREAM_DRAW);
+			glUseProgram(gl->strokeShader.prog);
+			glUniform1i(gl->strokeShader.loc[GLNVG_LOC_TEX], 0);
+			glUniform2fv(gl->strokeShader.loc[GLNVG_LOC_VIEWSIZE], 1, gl->view);
+			glUseProgram(gl->shader.prog);
+		}
+#endif
+#if NANOVG_GL_USE_DERIVATIVES
+		if (gl->flags & NVG_CURVE_FILLS) {
+			glUseProgram(gl->curveShader.prog);
+			glUniform1i(gl->curveShader.loc[GLNVG_LOC_TEX], 0);
+			glUniform2fv(gl->curveShader.loc[GLNVG_LOC_VIEWSIZE], 1, gl->view);
+			glUseProgram(gl->shader.prog);
+		}
+#endif
+		if (gl->flags & NVG_HAIRLINE_SHADER) {
+			glUseProgram(gl->lineShader.prog);
+			glUniform1i(gl->lineShader.loc[GLNVG_LOC_TEX], 0);
+			glUniform2fv(gl->lineShader.loc[GLNVG_LOC_VIEWSIZE], 1, gl->view);
+			glUseProgram(gl->shader.prog);
+		}
 		glBindBuffer(GL_ARRAY_BUFFER, gl->vertBuf);
 		glBufferData(GL_ARRAY_BUFFER, gl->nverts * sizeof(NVGvertex), gl->verts, GL_STREAM_DRAW);
 		glEnableVertexAttribArray(0);
@@ -1227,7 +1927,12 @@ static void glnvg__renderFlush(void* uptr)
 		for (i = 0; i < gl->ncalls; i++) {
 			GLNVGcall* call = &gl->calls[i];
 			glnvg__blendFuncSeparate(gl,&call->blendFunc);
-			if (call->type == GLNVG_FILL)
+			glnvg__scissor(gl, call);
+			if (call->type == GLNVG_FILL && call->batchCount > 1) {
+				glnvg__fillBatch(gl, call);
+				i += call->batchCount - 1;
+			}
+			else if (call->type == GLNVG_FILL)
 				glnvg__fill(gl, call);
 			else if (call->type == GLNVG_CONVEXFILL)
 				glnvg__convexFill(gl, call);
@@ -1235,6 +1940,18 @@ static void glnvg__renderFlush(void* uptr)
 				glnvg__stroke(gl, call);
 			else if (call->type == GLNVG_TRIANGLES)
 				glnvg__triangles(gl, call);
+			else if (call->type == GLNVG_SHAPE)
+				glnvg__shape(gl, call);
+			else if (call->type == GLNVG_HAIRLINE)
+				glnvg__hairlines(gl, call);
+#if NANOVG_GL_USE_INSTANCING
+			else if (call->type == GLNVG_STROKEPOINTS)
+				glnvg__strokePoints(gl, call);
+#endif
+#if NANOVG_GL_USE_DERIVATIVES
+			else if (call->type == GLNVG_CURVEFILL)
+				glnvg__curveFill(gl, call);
+#endif
 		}
 
 		glDisableVertexAttribArray(0);
@@ -1243,6 +1960,7 @@ static void glnvg__renderFlush(void* uptr)
 		glBindVertexArray(0);
 #endif
 		glDisable(GL_CULL_FACE);
+		glDisable(GL_SCISSOR_TEST);
 			glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glUseProgram(0);
 		glnvg__bindTexture(gl, 0);
@@ -1250,6 +1968,7 @@ static void glnvg__renderFlush(void* uptr)
 
 	// Reset calls
 	gl->nverts = 0;
+	gl->npoints = 0;
 	gl->npaths = 0;
 	gl->ncalls = 0;
 	gl->nuniforms = 0;
@@ -1261,6 +1980,7 @@ static int glnvg__maxVertCount(const NVGpath* paths, int npaths)
 	for (i = 0; i < npaths; i++) {
 		count += paths[i].nfill;
 		count += paths[i].nstroke;
+		count += paths[i].ncurve;
 	}
 	return count;
 }
@@ -1313,6 +2033,24 @@ static int glnvg__allocVerts(GLNVGcontext* gl, int n)
 	return ret;
 }
 
+#if NANOVG_GL_USE_INSTANCING
+static int glnvg__allocPoints(GLNVGcontext* gl, int n)
+{
+	int ret = 0;
+	if (gl->npoints+n > gl->cpoints) {
+		float* points;
+		int cpoints = glnvg__maxi(gl->npoints + n, 4096) + gl->cpoints/2; // 1.5x Overallocate
+		points = (float*)realloc(gl->points, sizeof(float) * 2 * cpoints);
+		if (points == NULL) return -1;
+		gl->points = points;
+		gl->cpoints = cpoints;
+	}
+	ret = gl->npoints;
+	gl->npoints += n;
+	return ret;
+}
+#endif
+
 static int glnvg__allocFragUniforms(GLNVGcontext* gl, int n)
 {
 	int ret = 0, structSize = gl->fragSize;
@@ -1349,7 +2087,8 @@ static void glnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperation
 	GLNVGcall* call = glnvg__allocCall(gl);
 	NVGvertex* quad;
 	GLNVGfragUniforms* frag;
-	int i, maxverts, offset;
+	float cover[4];
+	int i, maxverts, offset, first, nconvex = 0, ncurves = 0;
 
 	if (call == NULL) return;
 
@@ -1360,22 +2099,44 @@ static void glnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperation
 	call->pathCount = npaths;
 	call->image = paint->image;
 	call->blendFunc = glnvg__blendCompositeOperation(compositeOperation);
+	glnvg__setupScissor(call, scissor, fringe);
 
-	if (npaths == 1 && paths[0].convex)
+	// The cover quad only needs to span the paths that go through the stencil.
+	cover[0] = cover[1] = 1e6f;
+	cover[2] = cover[3] = -1e6f;
+	for (i = 0; i < npaths; i++) {
+		ncurves += paths[i].ncurve;
+		if (paths[i].convex || paths[i].triangulated) {
+			nconvex++;
+		} else {
+			cover[0] = glnvg__minf(cover[0], paths[i].bounds[0]);
+			cover[1] = glnvg__minf(cover[1], paths[i].bounds[1]);
+			cover[2] = glnvg__maxf(cover[2], paths[i].bounds[2]);
+			cover[3] = glnvg__maxf(cover[3], paths[i].bounds[3]);
+		}
+	}
+
+	if (nconvex == npaths)
 	{
 		call->type = GLNVG_CONVEXFILL;
 		call->triangleCount = 0;	// Bounding box fill quad not needed for convex fill
 	}
+	else if (ncurves > 0)
+	{
+		call->type = GLNVG_CURVEFILL;
+	}
 
 	// Allocate vertices for all the paths.
 	maxverts = glnvg__maxVertCount(paths, npaths) + call->triangleCount;
-	offset = glnvg__allocVerts(gl, maxverts);
+	offset = first = glnvg__allocVerts(gl, maxverts);
 	if (offset == -1) goto error;
 
 	for (i = 0; i < npaths; i++) {
 		GLNVGpath* copy = &gl->paths[call->pathOffset + i];
 		const NVGpath* path = &paths[i];
 		memset(copy, 0, sizeof(GLNVGpath));
+		copy->convex = path->convex || path->triangulated;
+		copy->fillMode = path->triangulated ? GL_TRIANGLES : GL_TRIANGLE_FAN;
 		if (path->nfill > 0) {
 			copy->fillOffset = offset;
 			copy->fillCount = path->nfill;
@@ -1388,27 +2149,45 @@ static void glnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperation
 			memcpy(&gl->verts[offset], path->stroke, sizeof(NVGvertex) * path->nstroke);
 			offset += path->nstroke;
 		}
+		if (path->ncurve > 0) {
+			copy->curveOffset = offset;
+			copy->curveCount = path->ncurve;
+			memcpy(&gl->verts[offset], path->curve, sizeof(NVGvertex) * path->ncurve);
+			offset += path->ncurve;
+		}
 	}
+	// The miters of the fringes reach further out than the fringe width.
+	glnvg__vertBounds(call->bounds, &gl->verts[first], offset - first);
+	// The control points of the curves and the fringes are only in the vertex bounds.
+	if (call->type == GLNVG_CURVEFILL)
+		memcpy(cover, call->bounds, sizeof(cover));
 
 	// Setup uniforms for draw calls
-	if (call->type == GLNVG_FILL) {
+	if (call->type == GLNVG_FILL || call->type == GLNVG_CURVEFILL) {
 		// Quad
 		call->triangleOffset = offset;
 		quad = &gl->verts[call->triangleOffset];
-		glnvg__vset(&quad[0], bounds[2], bounds[3], 0.5f, 1.0f);
-		glnvg__vset(&quad[1], bounds[2], bounds[1], 0.5f, 1.0f);
-		glnvg__vset(&quad[2], bounds[0], bounds[3], 0.5f, 1.0f);
-		glnvg__vset(&quad[3], bounds[0], bounds[1], 0.5f, 1.0f);
+		glnvg__vset(&quad[0], cover[2], cover[3], 0.5f, 1.0f);
+		glnvg__vset(&quad[1], cover[2], cover[1], 0.5f, 1.0f);
+		glnvg__vset(&quad[2], cover[0], cover[3], 0.5f, 1.0f);
+		glnvg__vset(&quad[3], cover[0], cover[1], 0.5f, 1.0f);
 
-		call->uniformOffset = glnvg__allocFragUniforms(gl, 2);
+		call->uniformOffset = glnvg__allocFragUniforms(gl, call->type == GLNVG_CURVEFILL ? 3 : 2);
 		if (call->uniformOffset == -1) goto error;
 		// Simple shader for stencil
 		frag = nvg__fragUniformPtr(gl, call->uniformOffset);
 		memset(frag, 0, sizeof(*frag));
 		frag->strokeThr = -1.0f;
 		frag->type = NSVG_SHADER_SIMPLE;
-		// Fill shader
-		glnvg__convertPaint(gl, nvg__fragUniformPtr(gl, call->uniformOffset + gl->fragSize), paint, scissor, fringe, fringe, -1.0f);
+		// Fill shader, the fringe outside of the curves skips the empty pixels so that they stay unmarked.
+		glnvg__convertPaint(gl, nvg__fragUniformPtr(gl, call->uniformOffset + gl->fragSize), paint, scissor, fringe, fringe,
+							call->type == GLNVG_CURVEFILL ? 0.5f/255.0f : -1.0f);
+		if (call->type == GLNVG_CURVEFILL) {
+			// Fill shader for the fringe inside of the curves
+			frag = nvg__fragUniformPtr(gl, call->uniformOffset + gl->fragSize*2);
+			glnvg__convertPaint(gl, frag, paint, scissor, fringe, fringe, -1.0f);
+			frag->strokeMult = -1.0f;
+		}
 	} else {
 		call->uniformOffset = glnvg__allocFragUniforms(gl, 1);
 		if (call->uniformOffset == -1) goto error;
@@ -1429,7 +2208,7 @@ static void glnvg__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperati
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
 	GLNVGcall* call = glnvg__allocCall(gl);
-	int i, maxverts, offset;
+	int i, maxverts, offset, first;
 
 	if (call == NULL) return;
 
@@ -1439,10 +2218,11 @@ static void glnvg__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperati
 	call->pathCount = npaths;
 	call->image = paint->image;
 	call->blendFunc = glnvg__blendCompositeOperation(compositeOperation);
+	glnvg__setupScissor(call, scissor, fringe);
 
 	// Allocate vertices for all the paths.
 	maxverts = glnvg__maxVertCount(paths, npaths);
-	offset = glnvg__allocVerts(gl, maxverts);
+	offset = first = glnvg__allocVerts(gl, maxverts);
 	if (offset == -1) goto error;
 
 	for (i = 0; i < npaths; i++) {
@@ -1456,6 +2236,7 @@ static void glnvg__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperati
 			offset += path->nstroke;
 		}
 	}
+	glnvg__vertBounds(call->bounds, &gl->verts[first], offset - first);
 
 	if (gl->flags & NVG_STENCIL_STROKES) {
 		// Fill shader
@@ -1480,6 +2261,147 @@ error:
 	if (gl->ncalls > 0) gl->ncalls--;
 }
 
+// Hairlines are strokes one pixel wide, the line shader draws them when the paint is a solid color.
+static void glnvg__renderHairlines(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+								   const NVGpath* paths, int npaths)
+{
+	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	int ncalls = gl->ncalls;
+
+	glnvg__renderStroke(uptr, paint, compositeOperation, scissor, fringe, fringe, paths, npaths);
+	if (gl->ncalls > ncalls && paint->image == 0 && (gl->flags & NVG_STENCIL_STROKES) == 0 &&
+		memcmp(&paint->innerColor, &paint->outerColor, sizeof(NVGcolor)) == 0)
+		gl->calls[gl->ncalls-1].type = GLNVG_HAIRLINE;
+}
+
+#if NANOVG_GL_USE_INSTANCING
+static void glnvg__renderStrokePoints(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+									  float strokeWidth, const NVGpath* paths, int npaths)
+{
+	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	GLNVGcall* call = glnvg__allocCall(gl);
+	int i, j, npoints = 0, offset;
+	float ext;
+
+	if (call == NULL) return;
+
+	call->type = GLNVG_STROKEPOINTS;
+	call->pathOffset = glnvg__allocPaths(gl, npaths);
+	if (call->pathOffset == -1) goto error;
+	call->pathCount = npaths;
+	call->image = paint->image;
+	call->strokeExtent = strokeWidth*0.5f + fringe*0.5f;
+	call->blendFunc = glnvg__blendCompositeOperation(compositeOperation);
+	glnvg__setupScissor(call, scissor, fringe);
+
+	// Allocate points for all the paths, closed paths repeat the first point.
+	for (i = 0; i < npaths; i++)
+		npoints += paths[i].nstroke + 1;
+	offset = glnvg__allocPoints(gl, npoints);
+	if (offset == -1) goto error;
+
+	for (i = 0; i < npaths; i++) {
+		GLNVGpath* copy = &gl->paths[call->pathOffset + i];
+		const NVGpath* path = &paths[i];
+		float* dst = &gl->points[offset*2];
+		memset(copy, 0, sizeof(GLNVGpath));
+		if (path->nstroke < 2) continue;
+		for (j = 0; j < path->nstroke; j++) {
+			dst[j*2+0] = path->stroke[j].x;
+			dst[j*2+1] = path->stroke[j].y;
+		}
+		if (path->closed) {
+			dst[j*2+0] = path->stroke[0].x;
+			dst[j*2+1] = path->stroke[0].y;
+			j++;
+		}
+		// Each instance draws the segment from a point to the next one.
+		copy->strokeOffset = offset;
+		copy->strokeCount = j-1;
+		offset += j;
+	}
+
+	// The corners of the segment quads reach up to sqrt(2) extents from the points.
+	glnvg__vertBounds(call->bounds, NULL, 0);
+	ext = call->strokeExtent * 1.4143f;
+	for (i = 0; i < npaths; i++) {
+		for (j = 0; j < paths[i].nstroke; j++) {
+			const NVGvertex* v = &paths[i].stroke[j];
+			call->bounds[0] = glnvg__minf(call->bounds[0], v->x - ext);
+			call->bounds[1] = glnvg__minf(call->bounds[1], v->y - ext);
+			call->bounds[2] = glnvg__maxf(call->bounds[2], v->x + ext);
+			call->bounds[3] = glnvg__maxf(call->bounds[3], v->y + ext);
+		}
+	}
+
+	// Fill shader
+	call->uniformOffset = glnvg__allocFragUniforms(gl, 2);
+	if (call->uniformOffset == -1) goto error;
+
+	glnvg__convertPaint(gl, nvg__fragUniformPtr(gl, call->uniformOffset), paint, scissor, strokeWidth, fringe, -1.0f);
+	glnvg__convertPaint(gl, nvg__fragUniformPtr(gl, call->uniformOffset + gl->fragSize), paint, scissor, strokeWidth, fringe, 1.0f - 0.5f/255.0f);
+
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (gl->ncalls > 0) gl->ncalls--;
+}
+#endif
+
+static void glnvg__renderShape(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+							   float strokeWidth, const NVGshape* shape)
+{
+	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	GLNVGcall* call = glnvg__allocCall(gl);
+	GLNVGfragUniforms* frag;
+	NVGvertex* quad;
+	const float* t = shape->xform;
+	float scale = sqrtf(t[0]*t[0] + t[1]*t[1]);
+	float k = scale / fringe;
+	float mx, my;
+	int i, flip = t[0]*t[3] - t[1]*t[2] < 0.0f;
+
+	if (call == NULL) return;
+
+	call->type = GLNVG_SHAPE;
+	call->image = paint->image;
+	call->blendFunc = glnvg__blendCompositeOperation(compositeOperation);
+	glnvg__setupScissor(call, scissor, fringe);
+
+	// Quad covering the shape, the stroke and the fringe, texture coordinates in fringe widths in shape space.
+	call->triangleOffset = glnvg__allocVerts(gl, 4);
+	if (call->triangleOffset == -1) goto error;
+	call->triangleCount = 4;
+	quad = &gl->verts[call->triangleOffset];
+	mx = shape->extent[0] + (strokeWidth*0.5f + fringe) / scale;
+	my = shape->extent[1] + (strokeWidth*0.5f + fringe) / scale;
+	for (i = 0; i < 4; i++) {
+		float x = (i & 2) ? -mx : mx;
+		float y = ((i & 1) ^ flip) ? -my : my;
+		glnvg__vset(&quad[i], t[0]*x + t[2]*y + t[4], t[1]*x + t[3]*y + t[5], x*k, y*k);
+	}
+	glnvg__vertBounds(call->bounds, quad, 4);
+
+	// Fill shader
+	call->uniformOffset = glnvg__allocFragUniforms(gl, 1);
+	if (call->uniformOffset == -1) goto error;
+	frag = nvg__fragUniformPtr(gl, call->uniformOffset);
+	glnvg__convertPaint(gl, frag, paint, scissor, fringe, fringe, -1.0f);
+	frag->shapeExt[0] = shape->extent[0] * k;
+	frag->shapeExt[1] = shape->extent[1] * k;
+	frag->shapeRadius = shape->type == NVG_SHAPE_ELLIPSE ? -1.0f : shape->radius * k;
+	frag->shapeStroke = strokeWidth / fringe;
+
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (gl->ncalls > 0) gl->ncalls--;
+}
+
 static void glnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
 								   const NVGvertex* verts, int nverts)
 {
@@ -1492,6 +2414,7 @@ static void glnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOper
 	call->type = GLNVG_TRIANGLES;
 	call->image = paint->image;
 	call->blendFunc = glnvg__blendCompositeOperation(compositeOperation);
+	glnvg__setupScissor(call, scissor, 1.0f);
 
 	// Allocate vertices for all the paths.
 	call->triangleOffset = glnvg__allocVerts(gl, nverts);
@@ -1499,6 +2422,7 @@ static void glnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOper
 	call->triangleCount = nverts;
 
 	memcpy(&gl->verts[call->triangleOffset], verts, sizeof(NVGvertex) * nverts);
+	glnvg__vertBounds(call->bounds, verts, nverts);
 
 	// Fill shader
 	call->uniformOffset = glnvg__allocFragUniforms(gl, 1);
@@ -1522,6 +2446,15 @@ static void glnvg__renderDelete(void* uptr)
 	if (gl == NULL) return;
 
 	glnvg__deleteShader(&gl->shader);
+#if NANOVG_GL_USE_INSTANCING
+	glnvg__deleteShader(&gl->strokeShader);
+	if (gl->pointBuf != 0)
+		glDeleteBuffers(1, &gl->pointBuf);
+#endif
+#if NANOVG_GL_USE_DERIVATIVES
+	glnvg__deleteShader(&gl->curveShader);
+#endif
+	glnvg__deleteShader(&gl->lineShader);
 
 #if NANOVG_GL3
 #if NANOVG_GL_USE_UNIFORMBUFFER
@@ -1542,8 +2475,10 @@ static void glnvg__renderDelete(void* uptr)
 
 	free(gl->paths);
 	free(gl->verts);
+	free(gl->points);
 	free(gl->uniforms);
 	free(gl->calls);
+	free(gl->sortedCalls);
 
 	free(gl);
 }
@@ -1576,10 +2511,26 @@ NVGcontext* nvgCreateGLES3(int flags)
 	params.renderFlush = glnvg__renderFlush;
 	params.renderFill = glnvg__renderFill;
 	params.renderStroke = glnvg__renderStroke;
+#if NANOVG_GL_USE_INSTANCING
+	if (flags & NVG_GPU_STROKES)
+		params.renderStrokePoints = glnvg__renderStrokePoints;
+#endif
+	if (flags & NVG_HAIRLINE_SHADER)
+		params.renderHairlines = glnvg__renderHairlines;
 	params.renderTriangles = glnvg__renderTriangles;
+	params.renderShape = glnvg__renderShape;
 	params.renderDelete = glnvg__renderDelete;
 	params.userPtr = gl;
 	params.edgeAntiAlias = flags & NVG_ANTIALIAS ? 1 : 0;
+#if NANOVG_GL_USE_DERIVATIVES
+	params.curveFills = flags & NVG_CURVE_FILLS ? 1 : 0;
+#endif
+	params.triangulateFills = flags & NVG_TRIANGULATE_FILLS ? 1 : 0;
+	params.sdfText = flags & NVG_SDF_TEXT ? 1 : 0;
+	params.sdfBlur = flags & NVG_SDF_BLUR ? 1 : 0;
+#ifdef NANOVG_GLES2
+	params.rowUpdates = 1;
+#endif
 
 	gl->flags = flags;
 